@@ -0,0 +1,250 @@
+// per pixel bookkeeping around a sample: which pixel an invocation works on, its sampler and
+// camera ray, and adding the finished sample to the accumulation, moments and feature images.
+// needs scene.glsl included first
+
+// per pixel luminance moments for adaptive sampling: x = sum(L), y = sum(L^2)
+layout (rg32f, binding = 1) uniform image2D imgMoments;
+// feature buffers of the first hit, averaged like the color and used to guide denoise.comp
+layout (rgba16f, binding = 2) uniform image2D imgAlbedo;
+layout (rgba32f, binding = 3) uniform image2D imgNormalDepth; // xyz = normal, w = hit distance
+// copies of the three images above from before the camera moved, only read while reprojecting
+layout (rg32f, binding = 5) readonly uniform image2D imgHistoryMoments;
+layout (rgba16f, binding = 6) readonly uniform image2D imgHistoryAlbedo;
+layout (rgba32f, binding = 7) readonly uniform image2D imgHistoryNormalDepth;
+
+uniform vec3 camPos;
+uniform vec3 camTarget;
+uniform vec3 camUp;
+uniform int frameCount;
+uniform vec2 resolution;
+// 1 traces every pixel, 2 or 4 only the middle pixel of every 2x2 or 4x4 block (progressive
+// rendering while the camera moves). its samples are spread over the whole block and
+// tonemap.comp fills the other pixels in
+uniform int renderScale;
+// when set, invocations trace the compacted list of unconverged pixels instead of the full image
+uniform int useActiveList;
+// where this dispatch starts when a frame is split into several (RayTracer::setFrameBudget),
+// in blocks or, for the active list, in list entries in x
+uniform ivec2 dispatchOffset;
+// SAMPLER_RANDOM or SAMPLER_SOBOL, see sampler.glsl
+uniform int samplerType;
+// set on the first frame after a camera move, the accumulation is then carried
+// over from the history images instead of starting from zero
+uniform int reproject;
+uniform vec3 prevCamPos;
+uniform vec3 prevCamTarget;
+uniform vec3 prevCamUp;
+// history older than this many samples is scaled down so stale shading fades out
+uniform float maxHistory;
+// relative hit distance difference above which a history sample counts as disoccluded
+uniform float depthTolerance;
+
+// written by adaptive.comp, pixel indices are y * width + x
+layout(std430, binding = 5) buffer ActivePixels {
+    uint activePixels[];
+};
+
+layout(std430, binding = 6) buffer AdaptiveDispatch {
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+    uint activeCount;
+};
+
+// sum of all radiance samples in xyz and the sample count in w, one entry per pixel (y * width + x).
+// doubles so millions of samples can be added without the running average drifting,
+// tonemap.comp turns this into the displayed image
+layout(std430, binding = 7) buffer Accumulation {
+    dvec4 accumulation[];
+};
+
+// the accumulation from before the camera moved
+layout(std430, binding = 8) readonly buffer HistoryAccumulation {
+    dvec4 historyAccumulation[];
+};
+
+// uv is the position on the image in [-1, 1]
+vec3 cameraRayDir(vec3 position, vec3 target, vec3 worldUp, vec2 uv) {
+    vec3 forward = normalize(target - position);
+    vec3 right = normalize(cross(forward, worldUp));
+    vec3 up = cross(right, forward);
+    float fov = 1.0;
+    float aspect = resolution.x / resolution.y;
+    return normalize(forward + uv.x * aspect * fov * right + uv.y * fov * up);
+}
+
+vec3 getRayDir(vec2 uv) {
+    return cameraRayDir(camPos, camTarget, camUp, uv);
+}
+
+// inverse of getRayDir for the camera before the move, gives the continuous pixel
+// position a world point was seen at (pixel centers sit at +0.5)
+bool projectToPrevious(vec3 worldPos, out vec2 pixel) {
+    vec3 forward = normalize(prevCamTarget - prevCamPos);
+    vec3 right = normalize(cross(forward, prevCamUp));
+    vec3 up = cross(right, forward);
+    float fov = 1.0;
+    float aspect = resolution.x / resolution.y;
+
+    vec3 toPoint = worldPos - prevCamPos;
+    float z = dot(toPoint, forward);
+    if (z <= 0.0) return false;
+
+    vec2 uv = vec2(dot(toPoint, right) / (z * aspect * fov), dot(toPoint, up) / (z * fov));
+    pixel = (uv + 1.0) * 0.5 * resolution;
+    return true;
+}
+
+// bilinear fetch of the history around where the primary hit was seen before the move,
+// taps that saw a different surface (depth or normal mismatch) are dropped and the rest
+// renormalized, returns false when nothing usable is left (disocclusion or off screen)
+bool fetchHistory(vec3 worldPos, PrimaryHit primary, out dvec4 accum, out vec2 moments, out vec3 albedo, out vec4 normalDepth) {
+    accum = dvec4(0.0);
+    moments = vec2(0.0);
+    albedo = vec3(0.0);
+    normalDepth = vec4(0.0);
+
+    vec2 pixel;
+    if (!projectToPrevious(worldPos, pixel)) return false;
+
+    vec2 samplePos = pixel - 0.5;
+    ivec2 base = ivec2(floor(samplePos));
+    vec2 f = samplePos - vec2(base);
+    float expectedDepth = primary.depth < SKY_DEPTH ? length(worldPos - prevCamPos) : SKY_DEPTH;
+
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 tap = base + offset;
+        if (any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, ivec2(resolution)))) continue;
+
+        vec4 tapNormalDepth = imageLoad(imgHistoryNormalDepth, tap);
+        if (abs(tapNormalDepth.w - expectedDepth) > depthTolerance * expectedDepth) continue;
+        if (primary.depth < SKY_DEPTH) {
+            float normalLength = length(tapNormalDepth.xyz);
+            if (normalLength < 1e-3 || dot(tapNormalDepth.xyz / normalLength, primary.normal) < 0.9) continue;
+        }
+
+        vec2 bilinear = mix(vec2(1.0) - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y;
+        // sums and counts are interpolated together, so the result is a count weighted mean
+        accum += historyAccumulation[tap.y * int(resolution.x) + tap.x] * double(weight);
+        moments += imageLoad(imgHistoryMoments, tap).xy * weight;
+        albedo += imageLoad(imgHistoryAlbedo, tap).rgb * weight;
+        normalDepth += tapNormalDepth * weight;
+        weightSum += weight;
+    }
+
+    if (weightSum < 1e-3) return false;
+
+    accum /= double(weightSum);
+    moments /= weightSum;
+    albedo /= weightSum;
+    normalDepth /= weightSum;
+
+    // history clamping, the sums keep their mean and variance but count for fewer samples
+    if (accum.w > double(maxHistory)) {
+        float scale = maxHistory / float(accum.w);
+        accum *= double(scale);
+        moments *= scale;
+    }
+    return true;
+}
+
+// size of the grid of blocks traced at renderScale
+ivec2 traceResolution() {
+    return (ivec2(resolution) + renderScale - 1) / renderScale;
+}
+
+// the pixel that holds the samples of a block
+ivec2 blockPixel(ivec2 block) {
+    return min(block * renderScale + renderScale / 2, ivec2(resolution) - 1);
+}
+
+// which pixel this invocation traces, false for invocations past the end of the image or list
+bool invocationPixel(out ivec2 texCoord) {
+    if (useActiveList != 0) {
+        // 1D dispatch over the compacted list, 256 invocations per group
+        uint activeIndex = uint(dispatchOffset.x) + gl_WorkGroupID.x * 256u + gl_LocalInvocationIndex;
+        if (activeIndex >= activeCount) return false;
+        uint pixel = activePixels[activeIndex];
+        texCoord = ivec2(int(pixel % uint(resolution.x)), int(pixel / uint(resolution.x)));
+        return true;
+    }
+    ivec2 block = ivec2(gl_GlobalInvocationID.xy) + dispatchOffset;
+    if (any(greaterThanEqual(block, traceResolution()))) return false;
+    texCoord = blockPixel(block);
+    return true;
+}
+
+bool restartPixel() {
+    return frameCount == 0 || reproject != 0;
+}
+
+// sampler of the pixel's sampleIndex-th sample in this frame, uv is where on the image
+// the jittered sample lands
+SamplerState startSample(ivec2 texCoord, uint sampleIndex, out vec2 uv) {
+    uint pixelIndex = uint(texCoord.x) + uint(texCoord.y) * uint(resolution.x);
+
+    // Generate unique seed for this pixel and frame with maximum entropy
+    uint base_seed = generate_seed(uvec2(texCoord), uint(frameCount), pixelIndex);
+    // the sobol scramble must not change between frames, only the sample index moves
+    uint pixelSeed = generate_seed(uvec2(texCoord), 0u, pixelIndex);
+
+    uint sample_seed = wang_hash(base_seed + uint(frameCount) * 7919u);
+    SamplerState sampleState = initSampler(samplerType, sample_seed, pixelSeed, sampleIndex);
+
+    // Generate random offsets for anti-aliasing
+    float randX = sampleNext(sampleState);
+    float randY = sampleNext(sampleState);
+    // jittered over the whole block the pixel stands in for
+    vec2 blockOrigin = vec2(texCoord / renderScale * renderScale);
+    uv = (blockOrigin + vec2(randX, randY) * float(renderScale)) / resolution * 2.0 - 1.0;
+    return sampleState;
+}
+
+// sampler for this frame's sample of the pixel and its camera ray
+SamplerState beginPixel(ivec2 texCoord, out Ray camRay) {
+    uint pixelIndex = uint(texCoord.x) + uint(texCoord.y) * uint(resolution.x);
+
+    // pixels can have different sample counts once adaptive sampling kicks in,
+    // so every pixel keeps its own count next to its radiance sum.
+    // a reprojected pixel does not know its count before tracing, any fresh sobol index works
+    uint sampleIndex = reproject != 0 ? uint(frameCount) : (restartPixel() ? 0u : uint(accumulation[pixelIndex].w));
+
+    vec2 uv;
+    SamplerState sampleState = startSample(texCoord, sampleIndex, uv);
+    camRay = Ray(camPos, getRayDir(uv));
+    return sampleState;
+}
+
+// adds a finished sample to the pixel, firstHitPos is where the camera ray ended and
+// is only used to find the pixel in the history after a camera move
+void finishPixel(ivec2 texCoord, vec3 col, PrimaryHit primary, vec3 firstHitPos) {
+    uint pixelIndex = uint(texCoord.x) + uint(texCoord.y) * uint(resolution.x);
+
+    bool restart = restartPixel();
+    dvec4 accum = restart ? dvec4(0.0) : accumulation[pixelIndex];
+    vec2 moments = restart ? vec2(0.0) : imageLoad(imgMoments, texCoord).xy;
+
+    vec3 prevAlbedo = vec3(0.0);
+    vec4 prevNormalDepth = vec4(0.0);
+    if (reproject != 0) {
+        // nothing usable leaves everything at zero, the pixel then starts over
+        fetchHistory(firstHitPos, primary, accum, moments, prevAlbedo, prevNormalDepth);
+    } else if (!restart) {
+        prevAlbedo = imageLoad(imgAlbedo, texCoord).rgb;
+        prevNormalDepth = imageLoad(imgNormalDepth, texCoord);
+    }
+    float n = float(accum.w);
+
+    // features are averaged over the same samples so edges come out anti aliased
+    imageStore(imgAlbedo, texCoord, vec4((prevAlbedo * n + primary.albedo) / (n + 1.0), 1.0));
+    imageStore(imgNormalDepth, texCoord, (prevNormalDepth * n + vec4(primary.normal, primary.depth)) / (n + 1.0));
+
+    float lum = dot(col, vec3(0.2126, 0.7152, 0.0722));
+    moments += vec2(lum, lum * lum);
+
+    accumulation[pixelIndex] = accum + dvec4(col, 1.0);
+    imageStore(imgMoments, texCoord, vec4(moments, 0.0, 0.0));
+}
@@ -0,0 +1,138 @@
+// random number generation shared by the tracing kernels, included with #include "sampler.glsl"
+// src/Sampler.cpp is the cpu copy of this file, keep the two in sync
+
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+
+uint wang_hash(uint seed) {
+    seed = (seed ^ 61u) ^ (seed >> 16u);
+    seed *= 9u;
+    seed = seed ^ (seed >> 4u);
+    seed *= 0x27d4eb2du;
+    seed = seed ^ (seed >> 15u);
+    return seed;
+}
+
+// the work group is derived from the pixel and not gl_WorkGroupID so the seed stays
+// the same whether the pixel was dispatched directly or through the active list
+uint generate_seed(uvec2 pixel, uint frame, uint invocation_id) {
+    uvec2 group = pixel / 16u;
+    uint seed = pixel.x;
+    seed = wang_hash(seed ^ pixel.y);
+    seed = wang_hash(seed ^ frame);
+    seed = wang_hash(seed ^ invocation_id);
+    seed = wang_hash(seed ^ group.x);
+    seed = wang_hash(seed ^ group.y);
+    return seed;
+}
+
+float RandomValue(inout uint state) {
+    state = wang_hash(state);
+    state = state * 747796405u + 2891336453u;
+    uint result = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    result = (result >> 22u) ^ result;
+    return result / 4294967295.0;
+}
+
+float RandomFloat(inout uint state) {
+    return RandomValue(state);
+}
+
+float RandomFloatRange(inout uint state, float min_val, float max_val) {
+    return min_val + (max_val - min_val) * RandomValue(state);
+}
+
+vec2 RandomVec2(inout uint state) {
+    return vec2(RandomValue(state), RandomValue(state));
+}
+
+vec3 RandomVec3(inout uint state) {
+    return vec3(RandomValue(state), RandomValue(state), RandomValue(state));
+}
+
+// generator matrices of the first 4 sobol dimensions (Joe & Kuo), higher dimensions
+// reuse them with an independent scramble so any path depth gets a 4D stratified pattern
+const uint sobolDirections[128] = uint[128](
+    // dimension 0
+    0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+    0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+    0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+    0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+    // dimension 1
+    0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+    0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+    0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+    0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+    // dimension 2
+    0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+    0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+    0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+    0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+    // dimension 3
+    0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+    0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+    0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+    0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+);
+
+uint sobol(uint index, uint dim) {
+    uint result = 0u;
+    for (uint bit = 0u; index != 0u; bit++, index >>= 1u) {
+        if ((index & 1u) != 0u) {
+            result ^= sobolDirections[dim * 32u + bit];
+        }
+    }
+    return result;
+}
+
+uint hash_combine(uint seed, uint value) {
+    return seed ^ (value + (seed << 6u) + (seed >> 2u));
+}
+
+// hash based owen scrambling from "Practical Hash-based Owen Scrambling" (Burley 2020)
+uint laine_karras_permutation(uint x, uint seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint nested_uniform_scramble(uint x, uint seed) {
+    x = bitfieldReverse(x);
+    x = laine_karras_permutation(x, seed);
+    return bitfieldReverse(x);
+}
+
+// scrambled sobol value of the given sample index and dimension,
+// seed decorrelates pixels so neighbours do not share the same pattern
+float sobol_owen(uint index, uint dimension, uint seed) {
+    uint groupSeed = hash_combine(seed, wang_hash(dimension / 4u));
+    uint shuffled = nested_uniform_scramble(index, groupSeed);
+    uint component = dimension % 4u;
+    uint x = nested_uniform_scramble(sobol(shuffled, component), hash_combine(groupSeed, component + 1u));
+    // 24 bits so the result is exactly representable and stays below 1
+    return float(x >> 8u) / 16777216.0;
+}
+
+// every random number a path needs comes from here, the dimension counter
+// makes the sobol sampler hand out a new dimension per call
+struct SamplerState {
+    int type;
+    uint rng;         // wang_hash / pcg state used by SAMPLER_RANDOM
+    uint pixelSeed;   // per pixel scramble, constant over frames
+    uint sampleIndex; // how many samples the pixel already has
+    uint dimension;
+};
+
+SamplerState initSampler(int type, uint rng, uint pixelSeed, uint sampleIndex) {
+    return SamplerState(type, rng, pixelSeed, sampleIndex, 0u);
+}
+
+float sampleNext(inout SamplerState sampleState) {
+    if (sampleState.type == SAMPLER_SOBOL) {
+        return sobol_owen(sampleState.sampleIndex, sampleState.dimension++, sampleState.pixelSeed);
+    }
+    return RandomValue(sampleState.rng);
+}
@@ -0,0 +1,411 @@
+// scene data and the ray queries every tracing kernel shares: the megakernel in raytracer.comp,
+// the wavefront passes (wavefront_*.comp) and the others include this, src/CpuRayTracer.cpp is the cpu copy
+
+uniform int numSpheres;
+uniform int numTriangles;
+uniform int numBVHNodes;
+
+struct Ray {
+    vec3 origin;
+    vec3 dir;
+};
+
+// Material.type, same as MATERIAL_* in src/Scene.h
+#define MATERIAL_LAMBERTIAN 0
+#define MATERIAL_EMISSIVE 1
+
+struct Material {
+    vec3 color;
+    int type;
+};
+
+struct Sphere {
+    vec3 center;
+    float radius;
+    Material material;
+};
+
+struct Triangle {
+    vec3 v0, v1, v2;
+    vec3 normal;
+    Material material;
+};
+
+// what the camera ray saw first, the denoiser is guided by these
+struct PrimaryHit {
+    vec3 albedo;
+    vec3 normal;
+    float depth;
+};
+
+struct AABB {
+    vec3 minPoint;
+    vec3 maxPoint;
+};
+
+struct BVHNode {
+    AABB bounds;
+    int leftChild;   // -1 if leaf
+    int rightChild;  // -1 if leaf
+    int firstTriIndex;
+    int triCount;
+};
+
+layout(std430, binding = 1) buffer Spheres {
+    float spheresData[];
+};
+
+layout(std430, binding = 2) buffer Triangles {
+    float trianglesData[];
+};
+
+layout(std430, binding = 3) buffer BVHNodes {
+    float bvhData[];
+};
+
+layout(std430, binding = 4) buffer BVHIndices {
+    float bvhIndicesData[];
+};
+
+// traversal counters, see RayTracer::setRayCounters. 64 bit running totals as (low, high) pairs:
+// rays of bounce 0 to RAY_COUNTER_BOUNCES - 1 (the last one also holds the deeper bounces),
+// then node visits, box tests and triangle tests. same order as src/RayCounters.h
+#define RAY_COUNTER_BOUNCES 8
+#define RAY_COUNTER_NODES RAY_COUNTER_BOUNCES
+#define RAY_COUNTER_AABBS (RAY_COUNTER_BOUNCES + 1)
+#define RAY_COUNTER_TRIANGLES (RAY_COUNTER_BOUNCES + 2)
+uniform bool rayCounters;
+
+layout(std430, binding = 15) buffer RayCounterTotals {
+    uint rayCounterData[2 * (RAY_COUNTER_BOUNCES + 3)];
+};
+
+// what the invocation's traversals did since the last countRay, kept in registers
+uint traversalNodeVisits = 0u;
+uint traversalAabbTests = 0u;
+uint traversalTriangleTests = 0u;
+
+// debug views, see DebugView in src/RayTracer.h. trace() keeps what its camera ray cost and
+// how many rays the path had
+#define DEBUG_VIEW_OFF 0
+#define DEBUG_VIEW_NODE_VISITS 1
+#define DEBUG_VIEW_TRIANGLE_TESTS 2
+#define DEBUG_VIEW_PATH_LENGTH 3
+uint cameraNodeVisits = 0u;
+uint cameraTriangleTests = 0u;
+int pathRays = 0;
+
+#define MAX_BOUNCES 1000
+// hit distance written for rays that escape to the sky
+#define SKY_DEPTH 1e4
+
+#include "sampler.glsl"
+
+vec3 randomUnitSphere(vec3 normal, inout SamplerState sampleState) {
+    float u1 = sampleNext(sampleState);
+    float u2 = sampleNext(sampleState);
+    
+    float r = sqrt(u1);
+    float theta = 2.0 * 3.14159265 * u2;
+    
+    vec3 tangent = normalize(cross(normal, abs(normal.x) < 0.5 ? vec3(1,0,0) : vec3(0,1,0)));
+    vec3 bitangent = cross(normal, tangent);
+
+    vec3 sampleDir = r * cos(theta) * tangent + r * sin(theta) * bitangent + sqrt(1.0 - u1) * normal;
+    return normalize(sampleDir);
+}
+
+vec3 randomHemisphere(vec3 normal, inout SamplerState sampleState) {
+    float u1 = sampleNext(sampleState);
+    float u2 = sampleNext(sampleState);
+    
+    float r = sqrt(u1);
+    float theta = 2.0 * 3.14159265 * u2;
+    
+    vec3 tangent = normalize(cross(normal, abs(normal.x) < 0.5 ? vec3(1,0,0) : vec3(0,1,0)));
+    vec3 bitangent = cross(normal, tangent);
+
+    vec3 sampleDir = r * cos(theta) * tangent + r * sin(theta) * bitangent + sqrt(1.0 - u1) * normal;
+    return normalize(sampleDir);
+}
+
+bool intersectSphere(Ray ray, Sphere sphere, float t_min, float t_max, out float t, out vec3 normal) {
+    vec3 oc = ray.origin - sphere.center;
+    float b = dot(oc, ray.dir);
+    float c = dot(oc, oc) - sphere.radius * sphere.radius;
+    float h = b*b - c;
+    if (h < 0.0) return false;
+    h = sqrt(h);
+    t = -b - h;
+    if (t < t_min || t > t_max) {
+        t = -b + h;
+        if (t < t_min || t > t_max) return false;
+    }
+
+    vec3 hitPoint = ray.origin + ray.dir * t;
+    normal = normalize(hitPoint - sphere.center);
+    return true;
+}
+
+// the exact same ray triangle intersection just like we did in the CPU based ray tracer
+bool intersectTriangle(Ray ray, Triangle triangle, float t_min, float t_max, out float t, out vec3 normal) {
+    const float epsilon = 1e-7;
+
+    vec3 edge1 = triangle.v1 - triangle.v0;
+    vec3 edge2 = triangle.v2 - triangle.v0;
+
+    vec3 pvec = cross(ray.dir, edge2);
+    float det = dot(edge1, pvec);
+
+    if (det > -epsilon && det < epsilon)
+        return false;
+
+    // Backface culling: if det < 0, the triangle is backfacing
+    //if (det < 0.0)
+        //return false;
+
+    float inv_det = 1.0 / det;
+    vec3 tvec = ray.origin - triangle.v0;
+    float u = inv_det * dot(tvec, pvec);
+
+    if (u < 0.0 || u > 1.0)
+        return false;
+
+    vec3 qvec = cross(tvec, edge1);
+    float v = inv_det * dot(ray.dir, qvec);
+
+    if (v < 0.0 || u + v > 1.0)
+        return false;
+
+    t = inv_det * dot(edge2, qvec);
+
+    if (t < t_min || t > t_max)
+        return false;
+
+    normal = triangle.normal;
+    return true;
+}
+
+bool intersectAABB(Ray ray, AABB aabb, float t_min, float t_max) {
+    for (int i = 0; i < 3; i++) {
+        float invD = 1.0 / ray.dir[i];
+        float t0 = (aabb.minPoint[i] - ray.origin[i]) * invD;
+        float t1 = (aabb.maxPoint[i] - ray.origin[i]) * invD;
+        
+        if (invD < 0.0) {
+            float temp = t0;
+            t0 = t1;
+            t1 = temp;
+        }
+        
+        t_min = max(t0, t_min);
+        t_max = min(t1, t_max);
+        
+        if (t_max < t_min) return false;
+    }
+    return true;
+}
+
+Triangle getTriangle(int index) {
+    int base = index * 16;
+    vec3 v0 = vec3(trianglesData[base], trianglesData[base+1], trianglesData[base+2]);
+    vec3 v1 = vec3(trianglesData[base+3], trianglesData[base+4], trianglesData[base+5]);
+    vec3 v2 = vec3(trianglesData[base+6], trianglesData[base+7], trianglesData[base+8]);
+    vec3 triNormal = vec3(trianglesData[base+9], trianglesData[base+10], trianglesData[base+11]);
+    vec3 color = vec3(trianglesData[base+12], trianglesData[base+13], trianglesData[base+14]);
+    int materialType = int(trianglesData[base+15]);
+    return Triangle(v0, v1, v2, triNormal, Material(color, materialType));
+}
+
+BVHNode getBVHNode(int index) {
+    int base = index * 12; // 12 floats per node (min(3) + pad(1) + max(3) + pad(1) + data(4))
+    vec3 minPoint = vec3(bvhData[base], bvhData[base+1], bvhData[base+2]);
+    vec3 maxPoint = vec3(bvhData[base+4], bvhData[base+5], bvhData[base+6]);
+    int leftChild = int(bvhData[base+8]);
+    int rightChild = int(bvhData[base+9]);
+    int firstTriIndex = int(bvhData[base+10]);
+    int triCount = int(bvhData[base+11]);
+    
+    BVHNode node;
+    node.bounds.minPoint = minPoint;
+    node.bounds.maxPoint = maxPoint;
+    node.leftChild = leftChild;
+    node.rightChild = rightChild;
+    node.firstTriIndex = firstTriIndex;
+    node.triCount = triCount;
+    return node;
+}
+
+bool intersectBVH(Ray ray, float t_min, float t_max, out float closestT, out Triangle hitTriangle) {
+    if (numBVHNodes == 0) return false;
+    
+    closestT = t_max;
+    bool hitSomething = false;
+    
+    int stack[64];
+    int stackPtr = 0;
+    stack[stackPtr++] = 0;
+    
+    while (stackPtr > 0) {
+        int nodeIndex = stack[--stackPtr];
+        BVHNode node = getBVHNode(nodeIndex);
+        
+        traversalAabbTests++;
+        if (!intersectAABB(ray, node.bounds, t_min, closestT)) {
+            continue;
+        }
+        
+        traversalNodeVisits++;
+        if (node.leftChild == -1 && node.rightChild == -1) {
+            traversalTriangleTests += uint(node.triCount);
+            for (int i = 0; i < node.triCount; i++) {
+                int triIndex = int(bvhIndicesData[node.firstTriIndex + i]);
+                Triangle triangle = getTriangle(triIndex);
+                
+                float t;
+                vec3 n;
+                if (intersectTriangle(ray, triangle, t_min, closestT, t, n) && t < closestT) {
+                    closestT = t;
+                    hitTriangle = triangle;
+                    hitSomething = true;
+                }
+            }
+        } else {
+            // Add children to stack (right first for left-to-right traversal)
+            if (node.rightChild != -1) {
+                stack[stackPtr++] = node.rightChild;
+            }
+            if (node.leftChild != -1) {
+                stack[stackPtr++] = node.leftChild;
+            }
+        }
+    }
+    
+    return hitSomething;
+}
+
+Sphere getSphere(int index) {
+    int base = index * 8;
+    vec3 center = vec3(spheresData[base], spheresData[base+1], spheresData[base+2]);
+    float radius = spheresData[base+3];
+    vec3 color = vec3(spheresData[base+4], spheresData[base+5], spheresData[base+6]);
+    int materialType = int(spheresData[base+7]);
+    return Sphere(center, radius, Material(color, materialType));
+}
+
+// closest hit over the spheres and the triangle BVH
+bool intersectScene(Ray ray, out float closestT, out vec3 normal, out Material material) {
+    closestT = 1e20;
+    bool hitSomething = false;
+
+    for(int i = 0; i < numSpheres; ++i) {
+        Sphere sphere = getSphere(i);
+        float t;
+        vec3 n;
+        if (intersectSphere(ray, sphere, 0.0, closestT, t, n) && t < closestT) {
+            closestT = t;
+            normal = n;
+            material = sphere.material;
+            hitSomething = true;
+        }
+    }
+
+    float triangleT;
+    Triangle bvhHitTriangle;
+    if (intersectBVH(ray, 0.001, closestT, triangleT, bvhHitTriangle) && triangleT < closestT) {
+        closestT = triangleT;
+        normal = bvhHitTriangle.normal;
+        material = bvhHitTriangle.material;
+        hitSomething = true;
+    }
+
+    return hitSomething;
+}
+
+void addRayCounter(int counter, uint value) {
+    if (value == 0u) return;
+    uint before = atomicAdd(rayCounterData[2 * counter], value);
+    // the low word wrapped, carry into the high one
+    if (before + value < before) {
+        atomicAdd(rayCounterData[2 * counter + 1], 1u);
+    }
+}
+
+// adds one ray of the given bounce and the traversal work since the last call to the totals.
+// a handful of atomics per ray, only paid while the counters are on
+void countRay(int bounce) {
+    if (!rayCounters) return;
+    addRayCounter(min(bounce, RAY_COUNTER_BOUNCES - 1), 1u);
+    addRayCounter(RAY_COUNTER_NODES, traversalNodeVisits);
+    addRayCounter(RAY_COUNTER_AABBS, traversalAabbTests);
+    addRayCounter(RAY_COUNTER_TRIANGLES, traversalTriangleTests);
+    traversalNodeVisits = 0u;
+    traversalAabbTests = 0u;
+    traversalTriangleTests = 0u;
+}
+
+// shades one bounce of a path given what its ray hit, returns false once the path is done.
+// on true the ray has been turned into the next bounce
+bool scatter(inout Ray ray, inout vec3 throughput, inout vec3 accumColor, inout PrimaryHit primary, int bounce,
+    bool hitSomething, float closestT, vec3 normal, Material material, inout SamplerState sampleState) {
+    if(!hitSomething) {
+        // black sky
+        vec3 sky = vec3(1);
+        accumColor += throughput * sky;
+        if (bounce == 0) {
+            primary.albedo = sky;
+        }
+        return false;
+    }
+
+    float bias = 1e-3 * length(ray.origin - (ray.origin + ray.dir * closestT));
+    vec3 hitPoint = ray.origin + ray.dir * closestT + normal * bias;
+
+    if (bounce == 0) {
+        primary = PrimaryHit(material.color, normal, closestT);
+    }
+
+    // different functions soon for different materials
+    if (material.type == MATERIAL_EMISSIVE) {
+        accumColor += throughput * material.color;
+        return false;
+    }
+
+    vec3 newDir = randomHemisphere(normal, sampleState);
+    ray = Ray(hitPoint, newDir);
+    throughput *= material.color;
+    return true;
+}
+
+// a whole path, one bounce after the other
+vec3 trace(Ray ray, inout SamplerState sampleState, out PrimaryHit primary) {
+    vec3 throughput = vec3(1.0);
+    vec3 accumColor = vec3(0.0);
+    primary = PrimaryHit(vec3(1.0), vec3(0.0), SKY_DEPTH);
+
+    for(int bounce = 0; bounce < MAX_BOUNCES; ++bounce) {
+        float closestT;
+        vec3 normal;
+        Material material;
+        bool hitSomething = intersectScene(ray, closestT, normal, material);
+        if (bounce == 0) {
+            cameraNodeVisits = traversalNodeVisits;
+            cameraTriangleTests = traversalTriangleTests;
+        }
+        pathRays = bounce + 1;
+        countRay(bounce);
+
+        if (!scatter(ray, throughput, accumColor, primary, bounce, hitSomething, closestT, normal, material, sampleState)) {
+            break;
+        }
+    }
+
+    return accumColor;
+}
+
+// what the last trace() cost by the given debug view
+float debugCost(int view) {
+    if (view == DEBUG_VIEW_NODE_VISITS) return float(cameraNodeVisits);
+    if (view == DEBUG_VIEW_TRIANGLE_TESTS) return float(cameraTriangleTests);
+    return float(pathRays);
+}
@@ -0,0 +1,40 @@
+// display transform shared by tonemap.comp and multiview.comp, src/ToneMap.cpp is the cpu copy
+
+#define TONEMAP_NONE 0
+#define TONEMAP_REINHARD 1
+#define TONEMAP_ACES 2
+
+// fitted ACES filmic curve (Narkowicz 2015)
+vec3 acesFilm(vec3 x) {
+    const float a = 2.51;
+    const float b = 0.03;
+    const float c = 2.43;
+    const float d = 0.59;
+    const float e = 0.14;
+    return clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0, 1.0);
+}
+
+vec3 toneMap(vec3 color, int toneMapper) {
+    if (toneMapper == TONEMAP_REINHARD) {
+        return color / (1.0 + color);
+    }
+    if (toneMapper == TONEMAP_ACES) {
+        return acesFilm(color);
+    }
+    return clamp(color, 0.0, 1.0);
+}
+
+// exposure in stops, then the tone mapper, then gamma
+vec3 displayColor(vec3 radiance, float exposure, int toneMapper, float gamma) {
+    vec3 color = toneMap(radiance * exp2(exposure), toneMapper);
+    return pow(color, vec3(1.0 / gamma));
+}
+
+// blue through green and yellow to red for t from 0 to 1, the debug views' color scale
+vec3 heatColor(float t) {
+    t = clamp(t, 0.0, 1.0);
+    vec3 low = mix(vec3(0.0, 0.0, 0.5), vec3(0.0, 0.8, 1.0), smoothstep(0.0, 0.25, t));
+    vec3 middle = mix(vec3(0.0, 0.8, 1.0), vec3(1.0, 1.0, 0.0), smoothstep(0.25, 0.6, t));
+    vec3 high = mix(vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), smoothstep(0.6, 1.0, t));
+    return t < 0.25 ? low : (t < 0.6 ? middle : high);
+}
@@ -0,0 +1,76 @@
+// state shared by the wavefront passes. instead of one invocation following a path from the camera
+// to the sky (raytracer.comp), every pass does one step for all paths that are still alive:
+//   wavefront_generate.comp    camera rays of the pixels traced this frame, one path each
+//   wavefront_extend.comp      closest hit of every ray in the input queue
+//   wavefront_shade.comp       shades those hits, paths that bounce go into the output queue
+//   wavefront_accumulate.comp  adds the finished paths to their pixels
+// RayTracer runs extend and shade once per bounce, swapping the two ray queues in between.
+// needs scene.glsl included first
+
+// everything a path carries between passes, 144 bytes
+struct PathState {
+    vec3 origin;
+    uint pixel;           // y * width + x
+    vec3 dir;
+    float hitT;           // written by extend, negative when the ray missed
+    vec3 throughput;
+    int hitMaterialType;
+    vec3 color;
+    int samplerType;
+    vec3 hitNormal;
+    uint rng;
+    vec3 hitColor;
+    uint pixelSeed;
+    vec3 albedo;          // primary hit, see PrimaryHit
+    uint sampleIndex;
+    vec3 normal;
+    float depth;
+    vec3 firstHitPos;     // where the camera ray ended, for reprojection
+    uint dimension;
+};
+
+// one entry per pixel, paths are numbered in the order generate created them
+layout(std430, binding = 9) buffer PathStates {
+    PathState paths[];
+};
+
+// two queues of path indices back to back, each queueCapacity entries long
+layout(std430, binding = 10) buffer RayQueues {
+    uint rayQueues[];
+};
+
+// the first three fields double as the indirect dispatch arguments of the pass
+// that reads the queue (256 invocations per group), the cpu resets them to (0, 1, 1, 0)
+struct QueueCounter {
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+    uint count;
+};
+
+// ray queues 0 and 1, then the number of paths generated this frame
+layout(std430, binding = 11) buffer WavefrontCounters {
+    QueueCounter counters[3];
+};
+
+#define PATH_COUNTER 2
+
+uniform int queueCapacity;
+
+void pushRay(int queue, uint pathIndex) {
+    uint index = atomicAdd(counters[queue].count, 1u);
+    rayQueues[uint(queue * queueCapacity) + index] = pathIndex;
+    atomicMax(counters[queue].numGroupsX, index / 256u + 1u);
+}
+
+SamplerState loadSampler(PathState path) {
+    return SamplerState(path.samplerType, path.rng, path.pixelSeed, path.sampleIndex, path.dimension);
+}
+
+void storeSampler(inout PathState path, SamplerState sampleState) {
+    path.samplerType = sampleState.type;
+    path.rng = sampleState.rng;
+    path.pixelSeed = sampleState.pixelSeed;
+    path.sampleIndex = sampleState.sampleIndex;
+    path.dimension = sampleState.dimension;
+}
@@ -0,0 +1,138 @@
+#include "BatchRunner.h"
+#include "ImageIO.h"
+#include "ToneMap.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// optional "r g b [type]" at the end of obj and sphere lines
+static Material readMaterial(std::istringstream& line)
+{
+    Material material = { {0.8f, 0.8f, 0.8f}, 0 };
+    glm::vec3 color;
+    if (line >> color.r >> color.g >> color.b) {
+        material.color = color;
+        int type;
+        if (line >> type) {
+            material.type = type;
+        }
+    }
+    return material;
+}
+
+bool loadBatchManifest(const std::string& path, BatchManifest& manifest)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Could not open manifest " << path << std::endl;
+        return false;
+    }
+
+    bool customScene = false;
+    std::vector<Sphere> spheres;
+    glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        lineNumber++;
+        text = text.substr(0, text.find('#'));
+        std::istringstream line(text);
+        std::string directive;
+        if (!(line >> directive)) {
+            continue;
+        }
+
+        bool ok = true;
+        if (directive == "size") {
+            ok = bool(line >> manifest.width >> manifest.height) && manifest.width > 0 && manifest.height > 0;
+        } else if (directive == "obj") {
+            std::string objPath;
+            ok = bool(line >> objPath);
+            if (ok) {
+                customScene = true;
+                ok = manifest.scene.loadOBJ(objPath, readMaterial(line));
+            }
+        } else if (directive == "sphere") {
+            Sphere sphere;
+            ok = bool(line >> sphere.center.x >> sphere.center.y >> sphere.center.z >> sphere.radius);
+            if (ok) {
+                sphere.material = readMaterial(line);
+                spheres.push_back(sphere);
+                customScene = true;
+            }
+        } else if (directive == "up") {
+            ok = bool(line >> up.x >> up.y >> up.z);
+        } else if (directive == "job") {
+            BatchJob job;
+            job.camera.up = up;
+            ok = bool(line >> job.camera.position.x >> job.camera.position.y >> job.camera.position.z
+                >> job.camera.target.x >> job.camera.target.y >> job.camera.target.z
+                >> job.samples >> job.output) && job.samples > 0;
+            if (ok) {
+                manifest.jobs.push_back(job);
+            }
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cout << path << ":" << lineNumber << ": can not use \"" << text << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    if (customScene) {
+        manifest.scene.setSpheres(spheres);
+        manifest.scene.buildBVH();
+    } else {
+        manifest.scene = Scene::defaultScene();
+    }
+    return true;
+}
+
+int runBatch(OfflineRenderer& renderer, const std::vector<BatchJob>& jobs, std::ostream& log, bool checkpoints)
+{
+    int failed = 0;
+    double totalSeconds = 0.0;
+    double totalSamples = 0.0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const BatchJob& job = jobs[i];
+        std::string checkpointPath = checkpoints ? job.output + ".checkpoint" : "";
+
+        // the checkpoint is only removed after the image is written, an image without one is done
+        if (checkpoints && std::ifstream(job.output) && !std::ifstream(checkpointPath)) {
+            log << "job " << i + 1 << "/" << jobs.size() << " " << job.output << ": already written" << std::endl;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<glm::vec4> image = averageAccumulation(renderer.render(job.camera, job.samples, checkpointPath));
+        // reading the accumulation back waits for the gpu, so this is the real tracing time
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool written;
+        if (renderer.onGpu() && renderer.getRayTracer()->getDebugView() != DebugView::Off) {
+            written = writeDebugView(job.output, renderer.getWidth(), renderer.getHeight(), image, renderer.getRayTracer()->getDebugScale());
+        } else {
+            written = writeRadiance(job.output, renderer.getWidth(), renderer.getHeight(), image);
+        }
+        if (!written) {
+            failed++;
+        } else if (checkpoints) {
+            std::remove(checkpointPath.c_str());
+        }
+
+        double samples = double(renderer.getWidth()) * renderer.getHeight() * job.samples;
+        totalSeconds += seconds;
+        totalSamples += samples;
+        log << "job " << i + 1 << "/" << jobs.size() << " " << job.output << ": " << job.samples << " spp in "
+            << seconds << " s, " << samples / seconds * 1e-6 << " Msamples/s" << (written ? "" : " (not written)") << std::endl;
+    }
+
+    if (totalSeconds > 0.0) {
+        log << jobs.size() << " jobs in " << totalSeconds << " s, " << totalSamples / totalSeconds * 1e-6 << " Msamples/s" << std::endl;
+    }
+    return failed;
+}
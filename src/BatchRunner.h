@@ -0,0 +1,40 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "OfflineRenderer.h"
+#include "Scene.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BatchJob {
+    RenderCamera camera;
+    int samples;
+    std::string output;
+};
+
+// a text file, one directive per line, # starts a comment:
+//   size <width> <height>                                  image size of every job (800 600)
+//   obj <path> [r g b [type]]                              mesh for the scene
+//   sphere <x> <y> <z> <radius> [r g b [type]]             sphere for the scene
+//   up <x> <y> <z>                                         camera up of the jobs that follow (0 1 0)
+//   job <px> <py> <pz> <tx> <ty> <tz> <samples> <output>   camera position, target, samples, image path
+// without any obj or sphere lines the jobs render the default scene
+struct BatchManifest {
+    int width = 800;
+    int height = 600;
+    Scene scene;
+    std::vector<BatchJob> jobs;
+};
+
+// prints what is wrong with the file (with its line number) and returns false
+bool loadBatchManifest(const std::string& path, BatchManifest& manifest);
+
+// renders the jobs back to back with the same renderer, so the scene is uploaded and its
+// BVH built once. prints the time of every job, returns how many could not be written.
+// with checkpoints every job saves its progress next to its output (<output>.checkpoint, see
+// OfflineRenderer::render) and a rerun of a killed batch skips the jobs that were written and
+// resumes the one that was cut off
+int runBatch(OfflineRenderer& renderer, const std::vector<BatchJob>& jobs, std::ostream& log, bool checkpoints = false);
+
+#endif // BATCH_RUNNER_H
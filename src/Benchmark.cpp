@@ -0,0 +1,421 @@
+#include "Benchmark.h"
+#include "OfflineRenderer.h"
+#include "RayCounters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+BenchmarkSuite defaultBenchmarkSuite()
+{
+    BenchmarkSuite suite;
+    suite.cases = {
+        { "default", "default", "orbit" },
+        { "cube", "cube.OBJ", "orbit" },
+        { "bunny", "bunny.obj", "orbit" },
+        { "bunny2", "bunny2.obj", "orbit" },
+        { "synthetic-1m", "synthetic:1000000", "orbit" },
+        { "synthetic-4m", "synthetic:4000000", "orbit" },
+    };
+    return suite;
+}
+
+bool loadBenchmarkSuite(const std::string& path, BenchmarkSuite& suite)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Could not open benchmark suite " << path << std::endl;
+        return false;
+    }
+
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        lineNumber++;
+        text = text.substr(0, text.find('#'));
+        std::istringstream line(text);
+        std::string directive;
+        if (!(line >> directive)) {
+            continue;
+        }
+
+        bool ok = true;
+        if (directive == "size") {
+            ok = bool(line >> suite.width >> suite.height) && suite.width > 0 && suite.height > 0;
+        } else if (directive == "orbit") {
+            ok = bool(line >> suite.orbitFrames) && suite.orbitFrames > 0;
+        } else if (directive == "warmup") {
+            ok = bool(line >> suite.warmupFrames) && suite.warmupFrames >= 0;
+        } else if (directive == "case") {
+            BenchmarkCase benchmarkCase;
+            ok = bool(line >> benchmarkCase.name >> benchmarkCase.scene >> benchmarkCase.path);
+            if (ok) {
+                suite.cases.push_back(benchmarkCase);
+            }
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cout << path << ":" << lineNumber << ": could not read \"" << text << "\"" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool saveCameraPath(const std::string& path, const std::vector<RenderCamera>& cameras)
+{
+    std::ofstream file(path);
+    file << "# position, target, up of every frame\n";
+    for (const RenderCamera& camera : cameras) {
+        file << camera.position.x << " " << camera.position.y << " " << camera.position.z << " "
+            << camera.target.x << " " << camera.target.y << " " << camera.target.z << " "
+            << camera.up.x << " " << camera.up.y << " " << camera.up.z << "\n";
+    }
+    if (!file) {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadCameraPath(const std::string& path, std::vector<RenderCamera>& cameras)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Could not open camera path " << path << std::endl;
+        return false;
+    }
+
+    cameras.clear();
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        lineNumber++;
+        text = text.substr(0, text.find('#'));
+        std::istringstream line(text);
+        RenderCamera camera;
+        if (!(line >> camera.position.x)) {
+            continue;
+        }
+        if (!(line >> camera.position.y >> camera.position.z >> camera.target.x >> camera.target.y >> camera.target.z
+            >> camera.up.x >> camera.up.y >> camera.up.z)) {
+            std::cout << path << ":" << lineNumber << ": could not read \"" << text << "\"" << std::endl;
+            return false;
+        }
+        cameras.push_back(camera);
+    }
+    if (cameras.empty()) {
+        std::cout << path << " has no cameras" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// two triangles per cell of the grid, a few octaves of waves for height so the bvh has to
+// deal with triangles of every orientation
+std::vector<Triangle> syntheticTriangles(int triangleCount)
+{
+    int cells = std::max(1, int(std::sqrt(double(triangleCount) / 2.0)));
+    auto height = [](float x, float z) {
+        return 0.6f * std::sin(1.3f * x) * std::cos(1.1f * z) + 0.2f * std::sin(4.7f * x + 2.0f * z)
+            + 0.05f * std::sin(17.0f * x) * std::sin(13.0f * z);
+    };
+    auto vertex = [cells, &height](int i, int k) {
+        float x = -3.0f + 6.0f * float(i) / float(cells);
+        float z = -3.0f + 6.0f * float(k) / float(cells);
+        return glm::vec3(x, height(x, z), z);
+    };
+
+    std::vector<Triangle> triangles;
+    triangles.reserve(size_t(cells) * cells * 2);
+    Material material = { {0.8f, 0.8f, 0.8f}, 0 };
+    auto addTriangle = [&triangles, &material](glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+        Triangle tri;
+        tri.v0 = v0;
+        tri.v1 = v1;
+        tri.v2 = v2;
+        tri.normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+        tri.material = material;
+        triangles.push_back(tri);
+    };
+    for (int k = 0; k < cells; k++) {
+        for (int i = 0; i < cells; i++) {
+            glm::vec3 a = vertex(i, k), b = vertex(i + 1, k), c = vertex(i + 1, k + 1), d = vertex(i, k + 1);
+            addTriangle(a, d, c);
+            addTriangle(a, c, b);
+        }
+    }
+    return triangles;
+}
+
+std::vector<RenderCamera> orbitPath(const Scene& scene, int frames)
+{
+    AABB bounds = scene.getBVHNodes().empty() ? AABB(glm::vec3(-1.0f), glm::vec3(1.0f)) : scene.getBVHNodes()[0].bounds;
+    glm::vec3 center = bounds.center();
+    float radius = glm::max(glm::length(bounds.max - bounds.min) * 0.5f, 1e-3f);
+
+    std::vector<RenderCamera> cameras;
+    for (int i = 0; i < frames; i++) {
+        float angle = 2.0f * 3.14159265f * float(i) / float(frames);
+        RenderCamera camera;
+        camera.position = center + glm::vec3(std::cos(angle) * 1.5f * radius, 0.35f * radius, std::sin(angle) * 1.5f * radius);
+        camera.target = center;
+        camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+        cameras.push_back(camera);
+    }
+    return cameras;
+}
+
+// the most the process held in memory so far, 0 where the platform has no way to ask
+static uint64_t peakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return uint64_t(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return uint64_t(std::strtoull(line.c_str() + 6, nullptr, 10)) * 1024;
+        }
+    }
+    return 0;
+#endif
+}
+
+static std::string jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool loadBenchmarkScene(const std::string& name, Scene& scene, double& loadMs, double& buildMs)
+{
+    loadMs = 0.0;
+    buildMs = 0.0;
+    if (name == "default") {
+        scene = Scene::defaultScene();
+        auto start = std::chrono::steady_clock::now();
+        scene.buildBVH();
+        buildMs = millisecondsSince(start);
+        return true;
+    }
+
+    if (name.compare(0, 10, "synthetic:") == 0) {
+        int triangleCount = std::atoi(name.c_str() + 10);
+        if (triangleCount <= 0) {
+            std::cout << "Synthetic scene " << name << " needs a triangle count" << std::endl;
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Triangle> triangles = syntheticTriangles(triangleCount);
+        loadMs = millisecondsSince(start);
+        start = std::chrono::steady_clock::now();
+        scene.setTriangles(triangles);
+        buildMs = millisecondsSince(start);
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!scene.loadOBJ(name)) {
+        return false;
+    }
+    loadMs = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    scene.buildBVH();
+    buildMs = millisecondsSince(start);
+    return true;
+}
+
+// one sample from the camera, waits for the gpu so the wall time covers the whole frame
+static void traceFrame(OfflineRenderer& renderer, const RenderCamera& camera)
+{
+    if (RayTracer* rayTracer = renderer.getRayTracer()) {
+        rayTracer->resetAccumulation();
+        rayTracer->render(camera.position, camera.target, camera.up);
+        glFinish();
+    } else {
+        CpuRayTracer* cpuRayTracer = renderer.getCpuRayTracer();
+        cpuRayTracer->resetAccumulation();
+        cpuRayTracer->render(camera.position, camera.target, camera.up);
+    }
+}
+
+bool runBenchmark(const BenchmarkSuite& suite, bool forceCpu, const std::function<void(RayTracer&)>& configureGpu,
+    const std::function<void(CpuRayTracer&)>& configureCpu, const std::string& jsonPath, std::ostream& log)
+{
+    std::ostringstream cases;
+    std::string renderer = "cpu";
+    bool gpu = false;
+    bool ok = true;
+
+    for (size_t c = 0; c < suite.cases.size(); c++) {
+        const BenchmarkCase& benchmarkCase = suite.cases[c];
+        log << "Benchmark " << benchmarkCase.name << ": " << benchmarkCase.scene << " along " << benchmarkCase.path << std::endl;
+
+        Scene scene;
+        double loadMs = 0.0;
+        double buildMs = 0.0;
+        if (!loadBenchmarkScene(benchmarkCase.scene, scene, loadMs, buildMs)) {
+            log << "  could not load " << benchmarkCase.scene << ", skipping" << std::endl;
+            ok = false;
+            continue;
+        }
+
+        std::vector<RenderCamera> cameras;
+        if (benchmarkCase.path == "orbit") {
+            cameras = orbitPath(scene, suite.orbitFrames);
+        } else if (!loadCameraPath(benchmarkCase.path, cameras)) {
+            log << "  could not load " << benchmarkCase.path << ", skipping" << std::endl;
+            ok = false;
+            continue;
+        }
+
+        size_t triangleCount = scene.getTriangles().size();
+        size_t nodeCount = scene.getBVHNodes().size();
+        // what the scene takes in the ssbos, std430 rounds triangles to 64 and nodes to 48 bytes
+        uint64_t sceneBytes = uint64_t(triangleCount) * 64 + uint64_t(nodeCount) * 48
+            + uint64_t(scene.getTriangleIndices().size()) * 4 + uint64_t(scene.getSpheres().size()) * 32;
+
+        OfflineRenderer offline(suite.width, suite.height, std::move(scene), forceCpu);
+        gpu = offline.onGpu();
+        if (gpu) {
+            renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+            configureGpu(*offline.getRayTracer());
+            offline.getRayTracer()->setRayCounters(false);
+            offline.getRayTracer()->getProfiler().setWindow(int(cameras.size()));
+        } else {
+            configureCpu(*offline.getCpuRayTracer());
+            offline.getCpuRayTracer()->setRayCounters(false);
+        }
+
+        for (int i = 0; i < suite.warmupFrames; i++) {
+            traceFrame(offline, cameras[size_t(i) % cameras.size()]);
+        }
+
+        if (gpu) {
+            offline.getRayTracer()->getProfiler().setEnabled(true);
+        }
+        std::vector<double> frameMs;
+        auto pathStart = std::chrono::steady_clock::now();
+        for (const RenderCamera& camera : cameras) {
+            auto start = std::chrono::steady_clock::now();
+            traceFrame(offline, camera);
+            frameMs.push_back(millisecondsSince(start));
+        }
+        double pathSeconds = millisecondsSince(pathStart) * 1e-3;
+
+        // the counters cost a few atomics per ray, so they get a pass of their own
+        RayCounters counters;
+        std::vector<GpuProfiler::StageStats> stages;
+        if (gpu) {
+            RayTracer* rayTracer = offline.getRayTracer();
+            // the profiler collects a few frames late, the frames of this pass would mix in
+            rayTracer->getProfiler().flush();
+            stages = rayTracer->getProfiler().getStats();
+            rayTracer->getProfiler().setEnabled(false);
+            rayTracer->setRayCounters(true);
+            rayTracer->resetRayCounters();
+            for (const RenderCamera& camera : cameras) {
+                traceFrame(offline, camera);
+            }
+            counters = rayTracer->getRayCounters(true);
+            rayTracer->setRayCounters(false);
+        } else {
+            CpuRayTracer* cpuRayTracer = offline.getCpuRayTracer();
+            cpuRayTracer->setRayCounters(true);
+            cpuRayTracer->resetRayCounters();
+            for (const RenderCamera& camera : cameras) {
+                traceFrame(offline, camera);
+            }
+            counters = cpuRayTracer->getRayCounters();
+            cpuRayTracer->setRayCounters(false);
+        }
+
+        std::vector<double> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) { return sorted[size_t(p * double(sorted.size() - 1) + 0.5)]; };
+        double meanMs = 0.0;
+        for (double ms : sorted) {
+            meanMs += ms;
+        }
+        meanMs /= double(sorted.size());
+
+        uint64_t rays = counters.totalRays();
+        double perRay = rays > 0 ? 1.0 / double(rays) : 0.0;
+        double mraysPerSecond = pathSeconds > 0.0 ? double(rays) / pathSeconds * 1e-6 : 0.0;
+
+        log << "  " << triangleCount << " triangles, bvh built in " << buildMs << " ms, " << cameras.size()
+            << " frames at " << meanMs << " ms (p99 " << percentile(0.99) << " ms), " << mraysPerSecond << " Mrays/s" << std::endl;
+
+        cases << (cases.tellp() > 0 ? ",\n" : "") << "    {\n"
+            << "      \"name\": " << jsonString(benchmarkCase.name) << ",\n"
+            << "      \"scene\": " << jsonString(benchmarkCase.scene) << ",\n"
+            << "      \"path\": " << jsonString(benchmarkCase.path) << ",\n"
+            << "      \"triangles\": " << triangleCount << ",\n"
+            << "      \"bvhNodes\": " << nodeCount << ",\n"
+            << "      \"loadMs\": " << loadMs << ",\n"
+            << "      \"bvhBuildMs\": " << buildMs << ",\n"
+            << "      \"frames\": " << frameMs.size() << ",\n"
+            << "      \"frameMs\": { \"mean\": " << meanMs << ", \"p50\": " << percentile(0.5) << ", \"p95\": " << percentile(0.95)
+            << ", \"p99\": " << percentile(0.99) << ", \"min\": " << sorted.front() << ", \"max\": " << sorted.back() << " },\n"
+            << "      \"rays\": " << rays << ",\n"
+            << "      \"mraysPerSecond\": " << mraysPerSecond << ",\n"
+            << "      \"perRay\": { \"nodeVisits\": " << double(counters.traversal.nodeVisits) * perRay
+            << ", \"aabbTests\": " << double(counters.traversal.aabbTests) * perRay
+            << ", \"triangleTests\": " << double(counters.traversal.triangleTests) * perRay << " },\n"
+            << "      \"raysByBounce\": [";
+        for (int i = 0; i < RAY_COUNTER_BOUNCES; i++) {
+            cases << (i > 0 ? ", " : "") << counters.rays[i];
+        }
+        cases << "],\n      \"gpuStageMs\": {";
+        for (size_t i = 0; i < stages.size(); i++) {
+            cases << (i > 0 ? ", " : " ") << jsonString(stages[i].name) << ": " << stages[i].averageMs;
+        }
+        cases << (stages.empty() ? "" : " ") << "},\n"
+            << "      \"sceneBufferBytes\": " << sceneBytes << ",\n"
+            << "      \"peakResidentBytes\": " << peakResidentBytes() << "\n"
+            << "    }";
+    }
+
+    std::ofstream file(jsonPath);
+    file << "{\n"
+        << "  \"renderer\": " << jsonString(renderer) << ",\n"
+        << "  \"backend\": " << jsonString(gpu ? "gpu" : "cpu") << ",\n"
+        << "  \"width\": " << suite.width << ",\n"
+        << "  \"height\": " << suite.height << ",\n"
+        << "  \"warmupFrames\": " << suite.warmupFrames << ",\n"
+        << "  \"cases\": [\n" << cases.str() << (cases.tellp() > 0 ? "\n" : "") << "  ]\n"
+        << "}\n";
+    if (!file) {
+        log << "Could not write " << jsonPath << std::endl;
+        return false;
+    }
+    log << "Benchmark results written to " << jsonPath << std::endl;
+    return ok;
+}
@@ -0,0 +1,65 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "CpuRayTracer.h"
+#include "RayTracer.h"
+#include "Scene.h"
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// one scene flown along one camera path
+struct BenchmarkCase {
+    std::string name;
+    // "default" (Scene::defaultScene), "synthetic:<triangles>" (a bumpy grid of about that many
+    // triangles) or the path of an obj file
+    std::string scene;
+    // "orbit" circles the scene's bounds, anything else is a file from saveCameraPath
+    std::string path;
+};
+
+// a text file like the batch manifest, one directive per line, # starts a comment:
+//   size <width> <height>          image size of every case (640 480)
+//   orbit <frames>                 cameras of the orbit path (120)
+//   warmup <frames>                untimed frames before every case (4)
+//   case <name> <scene> <path>     see BenchmarkCase
+struct BenchmarkSuite {
+    int width = 640;
+    int height = 480;
+    int orbitFrames = 120;
+    int warmupFrames = 4;
+    std::vector<BenchmarkCase> cases;
+};
+
+// the default scene, the three meshes of the repo on their own and synthetic scenes of one and
+// four million triangles, all on the orbit path
+BenchmarkSuite defaultBenchmarkSuite();
+// prints what is wrong with the file (with its line number) and returns false
+bool loadBenchmarkSuite(const std::string& path, BenchmarkSuite& suite);
+
+// makes the scene of a BenchmarkCase with its BVH, false when it could not be made, the times of
+// loading the file (or making the grid) and building the BVH are filled in otherwise
+bool loadBenchmarkScene(const std::string& name, Scene& scene, double& loadMs, double& buildMs);
+// the camera circles the bounds of the whole bvh a little above its center, once over the path
+std::vector<RenderCamera> orbitPath(const Scene& scene, int frames);
+
+// a bumpy grid over [-3, 3] in x and z of about triangleCount triangles, the "synthetic:" scenes
+std::vector<Triangle> syntheticTriangles(int triangleCount);
+
+// one camera per line, position, target and up
+bool saveCameraPath(const std::string& path, const std::vector<RenderCamera>& cameras);
+bool loadCameraPath(const std::string& path, std::vector<RenderCamera>& cameras);
+
+// Renders every case of the suite offscreen (on the cpu without a gpu or with forceCpu) and
+// writes one json file with, per case: the scene size, BVH build time, the frame time
+// percentiles of the path, Mrays/s with the bvh work per ray, the gpu stage times and the
+// memory the scene takes on the gpu and the process at its peak. Every frame is one sample from
+// a new camera, so adaptive sampling, reprojection and the denoiser play no part and the numbers
+// only move when the tracing does. The rays are counted in a second pass over the path since the
+// counters slow the trace down. configure gets every new tracer (kernel, threads, isa, ...).
+// false when a case could not be loaded or the file could not be written
+bool runBenchmark(const BenchmarkSuite& suite, bool forceCpu, const std::function<void(RayTracer&)>& configureGpu,
+    const std::function<void(CpuRayTracer&)>& configureCpu, const std::string& jsonPath, std::ostream& log);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,192 @@
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static const char CHECKPOINT_MAGIC[4] = { 'R', 'T', 'C', 'K' };
+static const uint32_t CHECKPOINT_VERSION = 2;
+
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t frameCount;
+    int32_t samplerType;
+    // position, target, up
+    float camera[9];
+    int32_t triangleCount;
+    uint64_t sceneChecksum;
+};
+
+// the structs are all floats and ints without padding, so their bytes are their contents
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t bytes)
+{
+    const unsigned char* begin = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; i++) {
+        hash = (hash ^ begin[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t sceneChecksum(const Scene& scene)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a(hash, scene.getSpheres().data(), scene.getSpheres().size() * sizeof(Sphere));
+    hash = fnv1a(hash, scene.getTriangles().data(), scene.getTriangles().size() * sizeof(Triangle));
+    hash = fnv1a(hash, scene.getBVHNodes().data(), scene.getBVHNodes().size() * sizeof(BVHNode));
+    hash = fnv1a(hash, scene.getTriangleIndices().data(), scene.getTriangleIndices().size() * sizeof(int));
+    return hash;
+}
+
+bool writeCheckpoint(const std::string& path, const Checkpoint& checkpoint)
+{
+    size_t pixels = size_t(checkpoint.width) * checkpoint.height;
+    if (checkpoint.accumulation.size() != pixels || checkpoint.albedo.size() != pixels || checkpoint.normalDepth.size() != pixels) {
+        std::cout << "Checkpoint buffers do not match its size, not writing " << path << std::endl;
+        return false;
+    }
+
+    CheckpointHeader header = {};
+    std::copy(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 4, header.magic);
+    header.version = CHECKPOINT_VERSION;
+    header.width = checkpoint.width;
+    header.height = checkpoint.height;
+    header.frameCount = checkpoint.frameCount;
+    header.samplerType = int32_t(checkpoint.samplerType);
+    header.triangleCount = checkpoint.triangleCount;
+    header.sceneChecksum = checkpoint.sceneChecksum;
+    const glm::vec3 vectors[3] = { checkpoint.camera.position, checkpoint.camera.target, checkpoint.camera.up };
+    for (int i = 0; i < 3; i++) {
+        for (int k = 0; k < 3; k++) {
+            header.camera[i * 3 + k] = vectors[i][k];
+        }
+    }
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(checkpoint.accumulation.data()), pixels * sizeof(glm::dvec4));
+        file.write(reinterpret_cast<const char*>(checkpoint.albedo.data()), pixels * sizeof(glm::vec4));
+        file.write(reinterpret_cast<const char*>(checkpoint.normalDepth.data()), pixels * sizeof(glm::vec4));
+        if (!file) {
+            std::cout << "Could not write " << temporary << std::endl;
+            return false;
+        }
+    }
+
+    // replaces the old checkpoint in one step, there is no moment without one. rename does that
+    // on posix but fails on windows when the target exists
+#ifdef _WIN32
+    if (!MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+#else
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+#endif
+        std::cout << "Could not move " << temporary << " to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool readCheckpoint(const std::string& path, Checkpoint& checkpoint)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    CheckpointHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !std::equal(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 4, header.magic) ||
+        header.version != CHECKPOINT_VERSION || header.width <= 0 || header.height <= 0 || header.frameCount < 0 ||
+        (header.samplerType != int32_t(SamplerType::Random) && header.samplerType != int32_t(SamplerType::Sobol)) ||
+        header.triangleCount < 0) {
+        std::cout << path << " is not a checkpoint" << std::endl;
+        return false;
+    }
+
+    checkpoint.width = header.width;
+    checkpoint.height = header.height;
+    checkpoint.frameCount = header.frameCount;
+    checkpoint.samplerType = SamplerType(header.samplerType);
+    checkpoint.triangleCount = header.triangleCount;
+    checkpoint.sceneChecksum = header.sceneChecksum;
+    checkpoint.camera.position = glm::vec3(header.camera[0], header.camera[1], header.camera[2]);
+    checkpoint.camera.target = glm::vec3(header.camera[3], header.camera[4], header.camera[5]);
+    checkpoint.camera.up = glm::vec3(header.camera[6], header.camera[7], header.camera[8]);
+
+    size_t pixels = size_t(header.width) * header.height;
+    checkpoint.accumulation.resize(pixels);
+    checkpoint.albedo.resize(pixels);
+    checkpoint.normalDepth.resize(pixels);
+    file.read(reinterpret_cast<char*>(checkpoint.accumulation.data()), pixels * sizeof(glm::dvec4));
+    file.read(reinterpret_cast<char*>(checkpoint.albedo.data()), pixels * sizeof(glm::vec4));
+    file.read(reinterpret_cast<char*>(checkpoint.normalDepth.data()), pixels * sizeof(glm::vec4));
+    if (!file) {
+        std::cout << path << " is cut short" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CheckpointWriter::CheckpointWriter()
+    : hasPending(false), writing(false), stopping(false)
+{
+    thread = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    thread.join();
+}
+
+void CheckpointWriter::save(const std::string& path, Checkpoint checkpoint)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingPath = path;
+        pending = std::move(checkpoint);
+        hasPending = true;
+    }
+    changed.notify_all();
+}
+
+void CheckpointWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return !hasPending && !writing; });
+}
+
+void CheckpointWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [this] { return hasPending || stopping; });
+        if (!hasPending) {
+            return;
+        }
+
+        std::string path = std::move(pendingPath);
+        Checkpoint checkpoint = std::move(pending);
+        hasPending = false;
+        writing = true;
+
+        lock.unlock();
+        writeCheckpoint(path, checkpoint);
+        lock.lock();
+
+        writing = false;
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "RayTracer.h"
+#include "Sampler.h"
+#include "Scene.h"
+#include <condition_variable>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// everything a render needs to carry on exactly where it stopped. frameCount is the number
+// of frames traced so far and with it the rng frame index of the next one
+struct Checkpoint {
+    int width = 0;
+    int height = 0;
+    RenderCamera camera;
+    int frameCount = 0;
+    SamplerType samplerType = SamplerType::Sobol;
+    // which scene the samples belong to, a checkpoint of another scene must not be resumed
+    int triangleCount = 0;
+    uint64_t sceneChecksum = 0;
+    // RayTracer::readAccumulation layout, the features are what the denoiser needs
+    std::vector<glm::dvec4> accumulation;
+    std::vector<glm::vec4> albedo;
+    std::vector<glm::vec4> normalDepth;
+};
+
+// fnv-1a over the spheres, triangles and bvh, changes with any edit to the geometry or materials
+uint64_t sceneChecksum(const Scene& scene);
+
+// binary, a small header and the buffers as they are. the file is written next to path and
+// renamed over it at the end, so a process killed while writing leaves the last one intact
+bool writeCheckpoint(const std::string& path, const Checkpoint& checkpoint);
+// false when the file is missing, cut short or not a checkpoint
+bool readCheckpoint(const std::string& path, Checkpoint& checkpoint);
+
+// Writes checkpoints on its own thread so the render does not wait for the disk. A save that
+// comes in while the last one is still being written replaces any save still waiting, only the
+// newest state is worth keeping
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+    // finishes the write in progress and the waiting one
+    ~CheckpointWriter();
+
+    void save(const std::string& path, Checkpoint checkpoint);
+    // blocks until nothing is waiting or being written
+    void wait();
+
+private:
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool hasPending;
+    bool writing;
+    bool stopping;
+    std::string pendingPath;
+    Checkpoint pending;
+
+    void run();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+};
+
+#endif // CHECKPOINT_H
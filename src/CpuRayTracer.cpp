@@ -0,0 +1,725 @@
+#include "CpuRayTracer.h"
+#include "Intersect.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+#define MAX_BOUNCES 1000
+// hit distance written for rays that escape to the sky
+#define SKY_DEPTH 1e4f
+
+// everything below is a line by line copy of raytracer.comp, keep the two in sync
+
+static glm::vec3 randomHemisphere(const glm::vec3& normal, SamplerState& sampleState) {
+    float u1 = sampleState.next();
+    float u2 = sampleState.next();
+
+    float r = std::sqrt(u1);
+    float theta = 2.0f * 3.14159265f * u2;
+
+    glm::vec3 tangent = glm::normalize(glm::cross(normal, std::abs(normal.x) < 0.5f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+
+    glm::vec3 sampleDir = r * std::cos(theta) * tangent + r * std::sin(theta) * bitangent + std::sqrt(1.0f - u1) * normal;
+    return glm::normalize(sampleDir);
+}
+
+// the counters of the tile the calling thread is tracing, null while nothing is counted
+static thread_local RayCounters* threadCounters = nullptr;
+
+// counts what the calling thread traces until it goes out of scope, then adds that to the totals
+struct CpuRayTracer::CounterScope {
+    CpuRayTracer& tracer;
+    RayCounters counters;
+
+    explicit CounterScope(CpuRayTracer& tracer) : tracer(tracer) {
+        threadCounters = tracer.rayCounting ? &counters : nullptr;
+    }
+
+    ~CounterScope() {
+        if (threadCounters) {
+            std::lock_guard<std::mutex> lock(tracer.rayCountersMutex);
+            tracer.rayCounters += counters;
+        }
+        threadCounters = nullptr;
+    }
+};
+
+static void countRay(int bounce) {
+    if (threadCounters) {
+        threadCounters->rays[bounce < RAY_COUNTER_BOUNCES ? bounce : RAY_COUNTER_BOUNCES - 1]++;
+    }
+}
+
+RayCounters CpuRayTracer::getRayCounters() const {
+    std::lock_guard<std::mutex> lock(rayCountersMutex);
+    return rayCounters;
+}
+
+void CpuRayTracer::resetRayCounters() {
+    std::lock_guard<std::mutex> lock(rayCountersMutex);
+    rayCounters = RayCounters();
+}
+
+// pixels per packet, roughly square so the camera rays stay close together
+static void packetShape(int lanes, int& packetWidth, int& packetHeight) {
+    packetHeight = lanes >= 16 ? 4 : 2;
+    packetWidth = lanes / packetHeight;
+}
+
+CpuRayTracer::CpuRayTracer(int width, int height, Scene scene)
+    : scene(std::move(scene)), width(width), height(height), frameCount(0), samplerType(SamplerType::Sobol),
+    packetTracing(detectSimdIsa() != SimdIsa::Scalar), wideTraversal(detectSimdIsa() != SimdIsa::Scalar), wavefront(false), rayCounting(false),
+    camPos(0.0f), camTarget(0.0f), camUp(0.0f), accumulation(size_t(width) * height), albedo(size_t(width) * height), normalDepth(size_t(width) * height)
+{
+    if (this->scene.getBVHNodes().empty()) {
+        this->scene.buildBVH();
+    }
+    packetTracer.setScene(this->scene);
+    wideBVH.build(this->scene, packetTracer.getIsa());
+}
+
+void CpuRayTracer::setSimdIsa(SimdIsa isa) {
+    packetTracer.setIsa(isa);
+    wideBVH.build(scene, packetTracer.getIsa());
+}
+
+void CpuRayTracer::render(const glm::vec3& cameraPos,
+    const glm::vec3& cameraTarget,
+    const glm::vec3& cameraUp)
+{
+    if (cameraPos != camPos || cameraTarget != camTarget || cameraUp != camUp) {
+        frameCount = 0;
+    }
+    camPos = cameraPos;
+    camTarget = cameraTarget;
+    camUp = cameraUp;
+    // the scheduler stats then cover this frame, all passes of a wavefront one included
+    scheduler.resetStats();
+
+    if (wavefront) {
+        renderWavefront();
+    } else {
+        // sky pixels finish after one ray while room pixels bounce many times,
+        // so the work goes out in small tiles that idle threads can steal
+        scheduler.run(width, height, [this](const Tile& tile) {
+            CounterScope scope(*this);
+            renderTile(tile);
+        });
+    }
+
+    frameCount++;
+}
+
+void CpuRayTracer::restoreAccumulation(const glm::vec3& cameraPos,
+    const glm::vec3& cameraTarget,
+    const glm::vec3& cameraUp,
+    int frames,
+    const std::vector<glm::dvec4>& savedAccumulation,
+    const std::vector<glm::vec4>& savedAlbedo,
+    const std::vector<glm::vec4>& savedNormalDepth)
+{
+    accumulation = savedAccumulation;
+    albedo = savedAlbedo;
+    normalDepth = savedNormalDepth;
+    camPos = cameraPos;
+    camTarget = cameraTarget;
+    camUp = cameraUp;
+    frameCount = frames;
+}
+
+void CpuRayTracer::renderRegion(const glm::vec3& cameraPos,
+    const glm::vec3& cameraTarget,
+    const glm::vec3& cameraUp,
+    const Tile& region)
+{
+    if (cameraPos != camPos || cameraTarget != camTarget || cameraUp != camUp) {
+        frameCount = 0;
+    }
+    camPos = cameraPos;
+    camTarget = cameraTarget;
+    camUp = cameraUp;
+
+    scheduler.resetStats();
+
+    // the region is split like a small image and its tiles moved back into place,
+    // always depth first since the wavefront streams cover the whole image
+    scheduler.run(region.x1 - region.x0, region.y1 - region.y0, [this, &region](const Tile& tile) {
+        CounterScope scope(*this);
+        renderTile({ tile.x0 + region.x0, tile.y0 + region.y0, tile.x1 + region.x0, tile.y1 + region.y0 });
+    });
+
+    frameCount++;
+}
+
+double CpuRayTracer::measurePrimaryRays(const glm::vec3& cameraPos,
+    const glm::vec3& cameraTarget,
+    const glm::vec3& cameraUp,
+    int frames)
+{
+    camPos = cameraPos;
+    camTarget = cameraTarget;
+    camUp = cameraUp;
+    frameCount = 0;
+
+    // summed so the compiler cannot drop the traversal
+    std::atomic<int> hitCount(0);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        scheduler.run(width, height, [this, &hitCount](const Tile& tile) { hitCount += intersectTile(tile); });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the accumulation was never written, the next render has to start over
+    frameCount = 0;
+    return double(width) * height * frames / seconds * 1e-6;
+}
+
+double CpuRayTracer::measureDiffuseRays(const glm::vec3& cameraPos,
+    const glm::vec3& cameraTarget,
+    const glm::vec3& cameraUp,
+    int frames)
+{
+    camPos = cameraPos;
+    camTarget = cameraTarget;
+    camUp = cameraUp;
+    frameCount = 0;
+
+    std::vector<Ray> rays(size_t(width) * height);
+    scheduler.run(width, height, [this, &rays](const Tile& tile) {
+        for (int y = tile.y0; y < tile.y1; y++) {
+            for (int x = tile.x0; x < tile.x1; x++) {
+                PixelSample sample = beginPixel(x, y);
+                Hit hit = intersectScene(sample.ray);
+                Ray& ray = rays[sample.pixelIndex];
+                if (hit.material == nullptr) {
+                    // escaped, measure its camera ray instead
+                    ray = sample.ray;
+                    continue;
+                }
+                float bias = 1e-3f * glm::length(sample.ray.origin - (sample.ray.origin + sample.ray.dir * hit.t));
+                ray.origin = sample.ray.origin + sample.ray.dir * hit.t + hit.normal * bias;
+                ray.dir = randomHemisphere(hit.normal, sample.sampleState);
+            }
+        }
+    });
+
+    std::atomic<int> hitCount(0);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        scheduler.run(width, height, [this, &rays, &hitCount](const Tile& tile) {
+            int hits = 0;
+            for (int y = tile.y0; y < tile.y1; y++) {
+                for (int x = tile.x0; x < tile.x1; x++) {
+                    hits += intersectScene(rays[size_t(y) * width + x]).material != nullptr;
+                }
+            }
+            hitCount += hits;
+        });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    frameCount = 0;
+    return double(width) * height * frames / seconds * 1e-6;
+}
+
+int CpuRayTracer::intersectTile(const Tile& tile) const {
+    int hitCount = 0;
+    if (!packetTracing) {
+        for (int y = tile.y0; y < tile.y1; y++) {
+            for (int x = tile.x0; x < tile.x1; x++) {
+                hitCount += intersectScene(beginPixel(x, y).ray).material != nullptr;
+            }
+        }
+        return hitCount;
+    }
+
+    int packetWidth, packetHeight;
+    packetShape(packetTracer.getWidth(), packetWidth, packetHeight);
+    for (int y = tile.y0; y < tile.y1; y += packetHeight) {
+        for (int x = tile.x0; x < tile.x1; x += packetWidth) {
+            RayPacket packet;
+            packet.tMin = 0.001f;
+            packet.activeMask = 0;
+            for (int lane = 0; lane < packetTracer.getWidth(); lane++) {
+                int px = std::min(x + lane % packetWidth, tile.x1 - 1);
+                int py = std::min(y + lane / packetWidth, tile.y1 - 1);
+                Ray ray = beginPixel(px, py).ray;
+                packet.originX[lane] = ray.origin.x;
+                packet.originY[lane] = ray.origin.y;
+                packet.originZ[lane] = ray.origin.z;
+                packet.dirX[lane] = ray.dir.x;
+                packet.dirY[lane] = ray.dir.y;
+                packet.dirZ[lane] = ray.dir.z;
+                packet.tMax[lane] = 1e20f;
+                packet.activeMask |= 1 << lane;
+            }
+            packetTracer.intersect(packet);
+            for (int lane = 0; lane < packetTracer.getWidth(); lane++) {
+                hitCount += packet.hitTriangle[lane] >= 0;
+            }
+        }
+    }
+    return hitCount;
+}
+
+void CpuRayTracer::renderTile(const Tile& tile) {
+    if (!packetTracing) {
+        for (int y = tile.y0; y < tile.y1; y++) {
+            for (int x = tile.x0; x < tile.x1; x++) {
+                tracePixel(x, y);
+            }
+        }
+        return;
+    }
+
+    int packetWidth, packetHeight;
+    packetShape(packetTracer.getWidth(), packetWidth, packetHeight);
+    for (int y = tile.y0; y < tile.y1; y += packetHeight) {
+        for (int x = tile.x0; x < tile.x1; x += packetWidth) {
+            Tile packetTile = { x, y, std::min(x + packetWidth, tile.x1), std::min(y + packetHeight, tile.y1) };
+            tracePacket(packetTile);
+        }
+    }
+}
+
+CpuRayTracer::PixelSample CpuRayTracer::beginPixel(int x, int y) const {
+    PixelSample sample;
+    sample.pixelIndex = uint32_t(x) + uint32_t(y) * uint32_t(width);
+
+    sample.restart = frameCount == 0;
+    sample.accum = sample.restart ? glm::dvec4(0.0) : accumulation[sample.pixelIndex];
+    uint32_t sampleIndex = uint32_t(sample.accum.w);
+
+    uint32_t baseSeed = generateSeed(x, y, uint32_t(frameCount), sample.pixelIndex);
+    uint32_t pixelSeed = generateSeed(x, y, 0u, sample.pixelIndex);
+
+    // one sample per frame like the shader's numSamples
+    uint32_t sampleSeed = wangHash(baseSeed + uint32_t(frameCount) * 7919u);
+    sample.sampleState = SamplerState(samplerType, sampleSeed, pixelSeed, sampleIndex);
+
+    float randX = sample.sampleState.next();
+    float randY = sample.sampleState.next();
+    glm::vec2 resolution = glm::vec2(float(width), float(height));
+    glm::vec2 uv = (glm::vec2(float(x), float(y)) + glm::vec2(randX, randY)) / resolution * 2.0f - 1.0f;
+
+    sample.ray = { camPos, getRayDir(uv) };
+    return sample;
+}
+
+void CpuRayTracer::finishPixel(const PixelSample& sample, const glm::vec3& col, const PrimaryHit& primary) {
+    uint32_t pixelIndex = sample.pixelIndex;
+    glm::vec3 prevAlbedo = sample.restart ? glm::vec3(0.0f) : glm::vec3(albedo[pixelIndex]);
+    glm::vec4 prevNormalDepth = sample.restart ? glm::vec4(0.0f) : normalDepth[pixelIndex];
+    float n = float(sample.accum.w);
+
+    albedo[pixelIndex] = glm::vec4((prevAlbedo * n + primary.albedo) / (n + 1.0f), 1.0f);
+    normalDepth[pixelIndex] = (prevNormalDepth * n + glm::vec4(primary.normal, primary.depth)) / (n + 1.0f);
+    accumulation[pixelIndex] = sample.accum + glm::dvec4(glm::dvec3(col), 1.0);
+}
+
+void CpuRayTracer::tracePixel(int x, int y) {
+    PixelSample sample = beginPixel(x, y);
+
+    PrimaryHit primary;
+    glm::vec3 col = trace(sample.ray, sample.sampleState, primary);
+
+    finishPixel(sample, col, primary);
+}
+
+void CpuRayTracer::tracePacket(const Tile& pixels) {
+    PixelSample samples[MAX_PACKET_WIDTH];
+    Hit hits[MAX_PACKET_WIDTH];
+    RayPacket packet;
+    packet.tMin = 0.001f;
+    packet.activeMask = 0;
+
+    int lanes = 0;
+    for (int y = pixels.y0; y < pixels.y1; y++) {
+        for (int x = pixels.x0; x < pixels.x1; x++) {
+            samples[lanes] = beginPixel(x, y);
+            // spheres stay single ray, they only shorten the rays before the bvh
+            hits[lanes] = intersectSpheres(samples[lanes].ray);
+
+            const Ray& ray = samples[lanes].ray;
+            packet.originX[lanes] = ray.origin.x;
+            packet.originY[lanes] = ray.origin.y;
+            packet.originZ[lanes] = ray.origin.z;
+            packet.dirX[lanes] = ray.dir.x;
+            packet.dirY[lanes] = ray.dir.y;
+            packet.dirZ[lanes] = ray.dir.z;
+            packet.tMax[lanes] = hits[lanes].t;
+            packet.activeMask |= 1 << lanes;
+            lanes++;
+        }
+    }
+    // partial packets at the image edge repeat the first ray so the unused lanes hold sane numbers
+    for (int i = lanes; i < packetTracer.getWidth(); i++) {
+        packet.originX[i] = packet.originX[0];
+        packet.originY[i] = packet.originY[0];
+        packet.originZ[i] = packet.originZ[0];
+        packet.dirX[i] = packet.dirX[0];
+        packet.dirY[i] = packet.dirY[0];
+        packet.dirZ[i] = packet.dirZ[0];
+        packet.tMax[i] = packet.tMax[0];
+    }
+
+    packetTracer.intersect(packet, threadCounters ? &threadCounters->traversal : nullptr);
+
+    // past the first hit the rays scatter in every direction, packets would just carry
+    // dead lanes around so every path continues on its own
+    const std::vector<Triangle>& triangles = scene.getTriangles();
+    for (int i = 0; i < lanes; i++) {
+        if (packet.hitTriangle[i] >= 0) {
+            const Triangle& triangle = triangles[packet.hitTriangle[i]];
+            hits[i] = { packet.tMax[i], triangle.normal, &triangle.material };
+        }
+
+        PrimaryHit primary;
+        glm::vec3 col = shade(samples[i].ray, hits[i], samples[i].sampleState, primary);
+        finishPixel(samples[i], col, primary);
+    }
+}
+
+bool CpuRayTracer::intersectBVH(const Ray& ray, float tMin, float tMax, float& closestT, const Triangle*& hitTriangle) const {
+    const std::vector<BVHNode>& nodes = scene.getBVHNodes();
+    const std::vector<int>& indices = scene.getTriangleIndices();
+    const std::vector<Triangle>& triangles = scene.getTriangles();
+    if (nodes.empty()) return false;
+
+    closestT = tMax;
+    bool hitSomething = false;
+
+    int stack[64];
+    int stackPtr = 0;
+    stack[stackPtr++] = 0;
+
+    while (stackPtr > 0) {
+        const BVHNode& node = nodes[stack[--stackPtr]];
+
+        if (threadCounters) {
+            threadCounters->traversal.aabbTests++;
+        }
+        if (!intersectAABB(ray.origin, ray.dir, node.bounds, tMin, closestT)) {
+            continue;
+        }
+
+        if (threadCounters) {
+            threadCounters->traversal.nodeVisits++;
+            threadCounters->traversal.triangleTests += node.isLeaf() ? node.triCount : 0;
+        }
+        if (node.isLeaf()) {
+            for (int i = 0; i < node.triCount; i++) {
+                const Triangle& triangle = triangles[indices[node.firstTriIndex + i]];
+
+                float t;
+                if (intersectTriangle(ray.origin, ray.dir, triangle, tMin, closestT, t) && t < closestT) {
+                    closestT = t;
+                    hitTriangle = &triangle;
+                    hitSomething = true;
+                }
+            }
+        } else {
+            // right first for left-to-right traversal
+            if (node.rightChild != -1) {
+                stack[stackPtr++] = node.rightChild;
+            }
+            if (node.leftChild != -1) {
+                stack[stackPtr++] = node.leftChild;
+            }
+        }
+    }
+
+    return hitSomething;
+}
+
+CpuRayTracer::Hit CpuRayTracer::intersectSpheres(const Ray& ray) const {
+    Hit hit = { 1e20f, glm::vec3(0.0f), nullptr };
+    for (const Sphere& sphere : scene.getSpheres()) {
+        float t;
+        glm::vec3 n;
+        if (intersectSphere(ray.origin, ray.dir, sphere, 0.0f, hit.t, t, n) && t < hit.t) {
+            hit = { t, n, &sphere.material };
+        }
+    }
+    return hit;
+}
+
+CpuRayTracer::Hit CpuRayTracer::intersectScene(const Ray& ray) const {
+    Hit hit = intersectSpheres(ray);
+
+    float triangleT;
+    if (wideTraversal) {
+        int triangleIndex;
+        TraversalCounts* counts = threadCounters ? &threadCounters->traversal : nullptr;
+        if (wideBVH.intersect(ray.origin, ray.dir, 0.001f, hit.t, triangleT, triangleIndex, counts) && triangleT < hit.t) {
+            const Triangle& triangle = scene.getTriangles()[triangleIndex];
+            hit = { triangleT, triangle.normal, &triangle.material };
+        }
+        return hit;
+    }
+
+    const Triangle* hitTriangle = nullptr;
+    if (intersectBVH(ray, 0.001f, hit.t, triangleT, hitTriangle) && triangleT < hit.t) {
+        hit = { triangleT, hitTriangle->normal, &hitTriangle->material };
+    }
+    return hit;
+}
+
+glm::vec3 CpuRayTracer::trace(Ray ray, SamplerState& sampleState, PrimaryHit& primary) const {
+    return shade(ray, intersectScene(ray), sampleState, primary);
+}
+
+glm::vec3 CpuRayTracer::shade(Ray ray, Hit hit, SamplerState& sampleState, PrimaryHit& primary) const {
+    Path path = { ray, glm::vec3(1.0f), glm::vec3(0.0f), { glm::vec3(1.0f), glm::vec3(0.0f), SKY_DEPTH } };
+
+    for (int bounce = 0; bounce < MAX_BOUNCES; ++bounce) {
+        if (bounce > 0) {
+            hit = intersectScene(path.ray);
+        }
+        // the first hit comes from the caller, every bounce is one ray either way
+        countRay(bounce);
+        if (!scatter(path, hit, bounce, sampleState)) {
+            break;
+        }
+    }
+
+    primary = path.primary;
+    return path.color;
+}
+
+bool CpuRayTracer::scatter(Path& path, const Hit& hit, int bounce, SamplerState& sampleState) const {
+    const Ray& ray = path.ray;
+    float closestT = hit.t;
+    glm::vec3 normal = hit.normal;
+    const Material* material = hit.material;
+
+    if (material == nullptr) {
+        glm::vec3 sky(1.0f);
+        path.color += path.throughput * sky;
+        if (bounce == 0) {
+            path.primary.albedo = sky;
+        }
+        return false;
+    }
+
+    float bias = 1e-3f * glm::length(ray.origin - (ray.origin + ray.dir * closestT));
+    glm::vec3 hitPoint = ray.origin + ray.dir * closestT + normal * bias;
+
+    if (bounce == 0) {
+        path.primary = { material->color, normal, closestT };
+    }
+
+    if (material->type == MATERIAL_EMISSIVE) {
+        path.color += path.throughput * material->color;
+        return false;
+    }
+
+    glm::vec3 newDir = randomHemisphere(normal, sampleState);
+    path.ray = { hitPoint, newDir };
+    path.throughput *= material->color;
+    return true;
+}
+
+// 10 bits of each coordinate interleaved
+static uint64_t morton3(uint32_t x, uint32_t y, uint32_t z) {
+    auto spread = [](uint64_t v) {
+        v &= 0x3ffu;
+        v = (v | (v << 16)) & 0x030000ffull;
+        v = (v | (v << 8)) & 0x0300f00full;
+        v = (v | (v << 4)) & 0x030c30c3ull;
+        v = (v | (v << 2)) & 0x09249249ull;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+uint64_t CpuRayTracer::rayKey(const Ray& ray, const AABB& bounds) const {
+    // the direction octant decides which children a ray visits first, so it goes on top
+    uint64_t octant = (ray.dir.x < 0.0f ? 1u : 0u) | (ray.dir.y < 0.0f ? 2u : 0u) | (ray.dir.z < 0.0f ? 4u : 0u);
+
+    glm::vec3 extent = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+    glm::vec3 cell = glm::clamp((ray.origin - bounds.min) / extent, 0.0f, 1.0f) * 1023.0f;
+    return (octant << 30) | morton3(uint32_t(cell.x), uint32_t(cell.y), uint32_t(cell.z));
+}
+
+// least significant digit first, so every pass is stable and keeps the order of the one before.
+// each chunk counts its digits on its own, a prefix sum over (digit, chunk) gives every chunk
+// where its rays of each digit go, then the chunks scatter in parallel
+void CpuRayTracer::sortStream(int chunkSize) {
+    // octant and 30 bits of morton code, see rayKey
+    const int keyBits = 33;
+    const int digitBits = 11;
+    const int digits = 1 << digitBits;
+    const int rayCount = int(streamRays.size());
+    const int chunkCount = (rayCount + chunkSize - 1) / chunkSize;
+
+    // the last few bounces leave a handful of rays, not worth waking the threads for
+    if (chunkCount <= 1) {
+        std::sort(streamRays.begin(), streamRays.end());
+        return;
+    }
+
+    streamRaysScratch.resize(rayCount);
+    streamHistograms.resize(size_t(chunkCount) * digits);
+    std::vector<uint32_t> digitTotals(digits);
+
+    for (int shift = 0; shift < keyBits; shift += digitBits) {
+        scheduler.runRange(rayCount, chunkSize, [this, chunkSize, digits, shift](int begin, int end) {
+            uint32_t* histogram = &streamHistograms[size_t(begin / chunkSize) * digits];
+            std::fill(histogram, histogram + digits, 0u);
+            for (int i = begin; i < end; i++) {
+                histogram[(streamRays[i].first >> shift) & (digits - 1)]++;
+            }
+        });
+
+        // totals per digit, their running sum, then the offsets of every chunk within its digit
+        scheduler.runRange(digits, 64, [this, chunkCount, digits, &digitTotals](int begin, int end) {
+            for (int digit = begin; digit < end; digit++) {
+                uint32_t total = 0;
+                for (int chunk = 0; chunk < chunkCount; chunk++) {
+                    total += streamHistograms[size_t(chunk) * digits + digit];
+                }
+                digitTotals[digit] = total;
+            }
+        });
+        uint32_t offset = 0;
+        for (uint32_t& total : digitTotals) {
+            uint32_t count = total;
+            total = offset;
+            offset += count;
+        }
+        scheduler.runRange(digits, 64, [this, chunkCount, digits, &digitTotals](int begin, int end) {
+            for (int digit = begin; digit < end; digit++) {
+                uint32_t offset = digitTotals[digit];
+                for (int chunk = 0; chunk < chunkCount; chunk++) {
+                    uint32_t& count = streamHistograms[size_t(chunk) * digits + digit];
+                    uint32_t chunkRays = count;
+                    count = offset;
+                    offset += chunkRays;
+                }
+            }
+        });
+
+        scheduler.runRange(rayCount, chunkSize, [this, chunkSize, digits, shift](int begin, int end) {
+            uint32_t* offsets = &streamHistograms[size_t(begin / chunkSize) * digits];
+            for (int i = begin; i < end; i++) {
+                streamRaysScratch[offsets[(streamRays[i].first >> shift) & (digits - 1)]++] = streamRays[i];
+            }
+        });
+        streamRays.swap(streamRaysScratch);
+    }
+}
+
+void CpuRayTracer::renderWavefront() {
+    const int pixelCount = width * height;
+    // big enough to amortize the scheduling, small enough to keep every thread busy
+    const int chunkSize = 4096;
+
+    streamSamples.resize(pixelCount);
+    streamPaths.resize(pixelCount);
+    streamHits.resize(pixelCount);
+    streamRays.resize(pixelCount);
+
+    // origins are binned inside the scene bounds
+    AABB bounds;
+    if (!scene.getBVHNodes().empty()) {
+        bounds = scene.getBVHNodes()[0].bounds;
+    }
+    for (const Sphere& sphere : scene.getSpheres()) {
+        bounds.expand(sphere.center - glm::vec3(sphere.radius));
+        bounds.expand(sphere.center + glm::vec3(sphere.radius));
+    }
+    bounds.expand(camPos);
+
+    // generate
+    scheduler.runRange(pixelCount, chunkSize, [this](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            streamSamples[i] = beginPixel(i % width, i / width);
+            streamPaths[i] = { streamSamples[i].ray, glm::vec3(1.0f), glm::vec3(0.0f), { glm::vec3(1.0f), glm::vec3(0.0f), SKY_DEPTH } };
+            streamRays[i].second = i;
+        }
+    });
+
+    for (int bounce = 0; bounce < MAX_BOUNCES && !streamRays.empty(); ++bounce) {
+        int rayCount = int(streamRays.size());
+        int chunkCount = (rayCount + chunkSize - 1) / chunkSize;
+
+        // sort the whole stream, rays that start close together and go the same way end up
+        // next to each other wherever their paths were the bounce before
+        scheduler.runRange(rayCount, chunkSize, [this, &bounds](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                streamRays[i].first = rayKey(streamPaths[streamRays[i].second].ray, bounds);
+            }
+        });
+        sortStream(chunkSize);
+
+        // extend
+        scheduler.runRange(rayCount, chunkSize, [this, bounce](int begin, int end) {
+            CounterScope scope(*this);
+            for (int i = begin; i < end; i++) {
+                int path = streamRays[i].second;
+                streamHits[path] = intersectScene(streamPaths[path].ray);
+                countRay(bounce);
+            }
+        });
+
+        // bin by material, misses and lights end their paths here so they are done in this
+        // single pass, the lambertian hits are collected per chunk in stream order
+        streamBinned.resize(rayCount);
+        streamChunkCounts.resize(chunkCount);
+        scheduler.runRange(rayCount, chunkSize, [this, chunkSize, bounce](int begin, int end) {
+            int binned = begin;
+            for (int i = begin; i < end; i++) {
+                int path = streamRays[i].second;
+                const Material* material = streamHits[path].material;
+                if (material == nullptr || material->type == MATERIAL_EMISSIVE) {
+                    scatter(streamPaths[path], streamHits[path], bounce, streamSamples[path].sampleState);
+                } else {
+                    streamBinned[binned++] = path;
+                }
+            }
+            streamChunkCounts[begin / chunkSize] = binned - begin;
+        });
+
+        // the chunks' lambertian hits packed into the front of the stream, still sorted
+        std::vector<int> chunkOffsets(chunkCount);
+        int survivors = 0;
+        for (int chunk = 0; chunk < chunkCount; chunk++) {
+            chunkOffsets[chunk] = survivors;
+            survivors += streamChunkCounts[chunk];
+        }
+        scheduler.runRange(rayCount, chunkSize, [this, chunkSize, &chunkOffsets](int begin, int) {
+            int chunk = begin / chunkSize;
+            for (int i = 0; i < streamChunkCounts[chunk]; i++) {
+                streamRays[chunkOffsets[chunk] + i].second = streamBinned[begin + i];
+            }
+        });
+        streamRays.resize(survivors);
+
+        // shade
+        scheduler.runRange(survivors, chunkSize, [this, bounce](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                int path = streamRays[i].second;
+                scatter(streamPaths[path], streamHits[path], bounce, streamSamples[path].sampleState);
+            }
+        });
+    }
+
+    // accumulate
+    scheduler.runRange(pixelCount, chunkSize, [this](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            finishPixel(streamSamples[i], streamPaths[i].color, streamPaths[i].primary);
+        }
+    });
+}
+
+glm::vec3 CpuRayTracer::getRayDir(const glm::vec2& uv) const {
+    glm::vec3 forward = glm::normalize(camTarget - camPos);
+    glm::vec3 right = glm::normalize(glm::cross(forward, camUp));
+    glm::vec3 up = glm::cross(right, forward);
+    float fov = 1.0f;
+    float aspect = float(width) / float(height);
+    return glm::normalize(forward + uv.x * aspect * fov * right + uv.y * fov * up);
+}
@@ -0,0 +1,215 @@
+#ifndef CPU_RAY_TRACER_H
+#define CPU_RAY_TRACER_H
+
+#include "Scene.h"
+#include "Sampler.h"
+#include "TileScheduler.h"
+#include "PacketTracer.h"
+#include "RayCounters.h"
+#include "WideBVH.h"
+#include <glm/glm.hpp>
+#include <mutex>
+#include <vector>
+
+// cpu port of shaders/raytracer.comp for machines without a gpu. trace, intersectBVH and
+// the samplers do the same float math in the same order as the shader, so with the same
+// scene, camera and frame count both backends walk identical paths and the results only
+// differ by the gpu's rounding (sin/cos, fused multiply adds). that makes it the reference
+// to diff shader changes against
+//
+// adaptive sampling and reprojection are gpu only, every call traces one sample for every
+// pixel and a camera move starts the accumulation over
+class CpuRayTracer {
+public:
+    CpuRayTracer(int width, int height, Scene scene);
+
+    void render(const glm::vec3& cameraPos,
+        const glm::vec3& cameraTarget,
+        const glm::vec3& cameraUp);
+
+    // like render but only traces the pixels inside region, the rest of the accumulation is
+    // left as it is. a pixel gets the same samples as in a full frame, so rendering an image
+    // piece by piece (on several machines, see DistributedRender.h) changes nothing
+    void renderRegion(const glm::vec3& cameraPos,
+        const glm::vec3& cameraTarget,
+        const glm::vec3& cameraUp,
+        const Tile& region);
+
+    // 0 uses every hardware thread
+    void setThreadCount(int count) { scheduler.setThreadCount(count); }
+    int getThreadCount() const { return scheduler.getThreadCount(); }
+    // tile size, tile order and the per thread stats of the last frame
+    TileScheduler& getScheduler() { return scheduler; }
+    const TileScheduler& getScheduler() const { return scheduler; }
+
+    void setSamplerType(SamplerType type) {
+        samplerType = type;
+        frameCount = 0;
+    }
+    SamplerType getSamplerType() const { return samplerType; }
+
+    // camera rays go through the bvh in packets with the widest simd the cpu has,
+    // the bounces after the first hit are always traced one ray at a time. on by default unless
+    // the cpu has no simd at all, the scalar packets are slower than single rays there
+    void setPacketTracing(bool enabled) { packetTracing = enabled; }
+    bool getPacketTracing() const { return packetTracing; }
+    // also rebuilds the wide bvh for the new width
+    void setSimdIsa(SimdIsa isa);
+    SimdIsa getSimdIsa() const { return packetTracer.getIsa(); }
+
+    // single rays (every bounce, and the camera rays without packets) walk a 4 or 8 wide
+    // copy of the bvh, off falls back to the binary traversal that mirrors the shader. off by
+    // default without simd, like packets
+    void setWideTraversal(bool enabled) { wideTraversal = enabled; }
+    bool getWideTraversal() const { return wideTraversal; }
+    int getWideBVHWidth() const { return wideBVH.getWidth(); }
+
+    // breadth first instead of one pixel's whole path at a time: every bounce is one batch of
+    // rays, sorted by direction octant and origin morton code before the traversal and shaded
+    // grouped by material afterwards, so neighbouring rays touch the same bvh nodes. costs a
+    // few bytes of state per pixel, the image is the same as in the depth first mode
+    void setWavefront(bool enabled) { wavefront = enabled; }
+    bool getWavefront() const { return wavefront; }
+
+    // counts the rays render and renderRegion trace and the bvh work they cost into running
+    // totals (RayCounters.h). every thread counts on its own and adds up once per tile, off
+    // the traversals only check for a null pointer
+    void setRayCounters(bool enabled) { rayCounting = enabled; }
+    bool getRayCountersEnabled() const { return rayCounting; }
+    RayCounters getRayCounters() const;
+    void resetRayCounters();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getFrameCount() const { return frameCount; }
+    // the next render starts the accumulation over
+    void resetAccumulation() { frameCount = 0; }
+    // puts back a saved accumulation and feature buffers (same layout as the getters below),
+    // the next render from the same camera carries on as if there had been no break
+    void restoreAccumulation(const glm::vec3& cameraPos,
+        const glm::vec3& cameraTarget,
+        const glm::vec3& cameraUp,
+        int frames,
+        const std::vector<glm::dvec4>& savedAccumulation,
+        const std::vector<glm::vec4>& savedAlbedo,
+        const std::vector<glm::vec4>& savedNormalDepth);
+    const Scene& getScene() const { return scene; }
+
+    // camera rays per second in millions, first hit only and no shading, with the current
+    // packet/isa settings. throws the accumulation away
+    double measurePrimaryRays(const glm::vec3& cameraPos,
+        const glm::vec3& cameraTarget,
+        const glm::vec3& cameraUp,
+        int frames);
+    // same for the rays leaving the first hit in a cosine weighted direction, the
+    // incoherent case. the rays are set up before the clock starts
+    double measureDiffuseRays(const glm::vec3& cameraPos,
+        const glm::vec3& cameraTarget,
+        const glm::vec3& cameraUp,
+        int frames);
+
+    // same layout as RayTracer::readAccumulation, sum rgb in xyz and sample count in w
+    const std::vector<glm::dvec4>& getAccumulation() const { return accumulation; }
+    const std::vector<glm::vec4>& getAlbedo() const { return albedo; }
+    // first hit normal in xyz and its distance in w
+    const std::vector<glm::vec4>& getNormalDepth() const { return normalDepth; }
+
+private:
+    // what the camera ray saw first, the denoiser is guided by these
+    struct PrimaryHit {
+        glm::vec3 albedo;
+        glm::vec3 normal;
+        float depth;
+    };
+
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 dir;
+    };
+
+    // closest surface along a ray, material is null when the ray escapes
+    struct Hit {
+        float t;
+        glm::vec3 normal;
+        const Material* material;
+    };
+
+    // a path in flight, ray is the next one to trace
+    struct Path {
+        Ray ray;
+        glm::vec3 throughput;
+        glm::vec3 color;
+        PrimaryHit primary;
+    };
+
+    // a pixel's state between generating its camera ray and writing the sample back
+    struct PixelSample {
+        uint32_t pixelIndex;
+        bool restart;
+        glm::dvec4 accum;
+        SamplerState sampleState;
+        Ray ray;
+    };
+
+    Scene scene;
+    int width;
+    int height;
+    TileScheduler scheduler;
+    int frameCount;
+    SamplerType samplerType;
+    PacketTracer packetTracer;
+    bool packetTracing;
+    WideBVH wideBVH;
+    bool wideTraversal;
+    bool wavefront;
+
+    bool rayCounting;
+    RayCounters rayCounters;
+    mutable std::mutex rayCountersMutex;
+    struct CounterScope;
+
+    glm::vec3 camPos;
+    glm::vec3 camTarget;
+    glm::vec3 camUp;
+
+    std::vector<glm::dvec4> accumulation;
+    std::vector<glm::vec4> albedo;
+    std::vector<glm::vec4> normalDepth;
+
+    // wavefront state, one entry per pixel, kept between frames to save the allocations
+    std::vector<PixelSample> streamSamples;
+    std::vector<Path> streamPaths;
+    std::vector<Hit> streamHits;
+    // (sort key, path index) of the rays still going
+    std::vector<std::pair<uint64_t, int>> streamRays;
+    // where sortStream scatters to, swapped with streamRays after every pass
+    std::vector<std::pair<uint64_t, int>> streamRaysScratch;
+    // digit counts of every chunk of the stream, turned into that chunk's output offsets
+    std::vector<uint32_t> streamHistograms;
+    // paths that carry on, binned by every chunk into its own range, and how many each had
+    std::vector<int> streamBinned;
+    std::vector<int> streamChunkCounts;
+
+    void renderTile(const Tile& tile);
+    PixelSample beginPixel(int x, int y) const;
+    void finishPixel(const PixelSample& sample, const glm::vec3& col, const PrimaryHit& primary);
+    void tracePixel(int x, int y);
+    void tracePacket(const Tile& pixels);
+    // first hits only, returns how many rays hit something
+    int intersectTile(const Tile& tile) const;
+    Hit intersectSpheres(const Ray& ray) const;
+    Hit intersectScene(const Ray& ray) const;
+    glm::vec3 trace(Ray ray, SamplerState& sampleState, PrimaryHit& primary) const;
+    // continues a path whose first hit is already known
+    glm::vec3 shade(Ray ray, Hit hit, SamplerState& sampleState, PrimaryHit& primary) const;
+    // one iteration of the shader's bounce loop, false once the path has ended
+    bool scatter(Path& path, const Hit& hit, int bounce, SamplerState& sampleState) const;
+    void renderWavefront();
+    uint64_t rayKey(const Ray& ray, const AABB& bounds) const;
+    // radix sorts streamRays by key over the whole stream, chunkSize items a task
+    void sortStream(int chunkSize);
+    bool intersectBVH(const Ray& ray, float tMin, float tMax, float& closestT, const Triangle*& hitTriangle) const;
+    glm::vec3 getRayDir(const glm::vec2& uv) const;
+};
+
+#endif // CPU_RAY_TRACER_H
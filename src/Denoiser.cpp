@@ -0,0 +1,95 @@
+#include "Denoiser.h"
+#include <algorithm>
+#include <cmath>
+
+// keeps black surfaces from blowing up the demodulated color
+static const float minAlbedo = 1e-3f;
+
+// B3 spline weights of the 5x5 kernel
+static const float kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+Denoiser::Denoiser()
+    : iterations(5), colorPhi(0.5f), normalPhi(0.1f), depthPhi(0.1f)
+{
+}
+
+std::vector<glm::vec4> Denoiser::denoise(const std::vector<glm::vec4>& color,
+    const std::vector<glm::vec4>& albedo,
+    const std::vector<glm::vec4>& normalDepth,
+    int width, int height) const
+{
+    std::vector<glm::vec4> ping(color.size());
+    std::vector<glm::vec4> pong(color.size());
+
+    for (int i = 0; i < iterations; i++) {
+        const std::vector<glm::vec4>& input = i == 0 ? color : (i % 2 == 1 ? ping : pong);
+        std::vector<glm::vec4>& output = i % 2 == 0 ? ping : pong;
+        filterPass(input, output, albedo, normalDepth, width, height, i);
+    }
+
+    if ((iterations - 1) % 2 == 0) {
+        return ping;
+    }
+    return pong;
+}
+
+void Denoiser::filterPass(const std::vector<glm::vec4>& input, std::vector<glm::vec4>& output,
+    const std::vector<glm::vec4>& albedo, const std::vector<glm::vec4>& normalDepth,
+    int width, int height, int pass) const
+{
+    const int stepWidth = 1 << pass;
+    const bool firstPass = pass == 0;
+    const bool lastPass = pass == iterations - 1;
+    // coarser levels only smooth what is left, so they get stricter on color
+    const float passColorPhi = colorPhi / float(1 << pass);
+
+    auto loadColor = [&](int index) {
+        glm::vec3 c = glm::vec3(input[index]);
+        if (firstPass) {
+            c /= glm::max(glm::vec3(albedo[index]), glm::vec3(minAlbedo));
+        }
+        return c;
+    };
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int center = y * width + x;
+            glm::vec3 centerColor = loadColor(center);
+            glm::vec4 centerNormalDepth = normalDepth[center];
+
+            glm::vec3 sum(0.0f);
+            float weightSum = 0.0f;
+
+            for (int dy = -2; dy <= 2; dy++) {
+                for (int dx = -2; dx <= 2; dx++) {
+                    int px = std::min(std::max(x + dx * stepWidth, 0), width - 1);
+                    int py = std::min(std::max(y + dy * stepWidth, 0), height - 1);
+                    int index = py * width + px;
+
+                    glm::vec3 c = loadColor(index);
+                    const glm::vec4& nd = normalDepth[index];
+
+                    glm::vec3 colorDelta = centerColor - c;
+                    float colorWeight = std::min(std::exp(-glm::dot(colorDelta, colorDelta) / passColorPhi), 1.0f);
+
+                    glm::vec3 normalDelta = glm::vec3(centerNormalDepth) - glm::vec3(nd);
+                    float normalDist = std::max(glm::dot(normalDelta, normalDelta) / float(stepWidth * stepWidth), 0.0f);
+                    float normalWeight = std::min(std::exp(-normalDist / normalPhi), 1.0f);
+
+                    float depthDelta = std::abs(centerNormalDepth.w - nd.w) / std::max(centerNormalDepth.w, 1e-3f);
+                    float depthWeight = std::min(std::exp(-depthDelta / depthPhi), 1.0f);
+
+                    float weight = colorWeight * normalWeight * depthWeight * kernel[std::abs(dx)] * kernel[std::abs(dy)];
+                    sum += c * weight;
+                    weightSum += weight;
+                }
+            }
+
+            glm::vec3 filtered = sum / weightSum;
+            if (lastPass) {
+                filtered *= glm::max(glm::vec3(albedo[center]), glm::vec3(minAlbedo));
+            }
+            output[center] = glm::vec4(filtered, 1.0f);
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// cpu version of shaders/denoise.comp for images that never touch the gpu (headless batch jobs),
+// same filter and same parameters so both paths give the same look
+class Denoiser {
+public:
+    Denoiser();
+
+    void setIterations(int newIterations) { iterations = glm::clamp(newIterations, 1, 10); }
+    void setSigmas(float newColorPhi, float newNormalPhi, float newDepthPhi) {
+        colorPhi = newColorPhi;
+        normalPhi = newNormalPhi;
+        depthPhi = newDepthPhi;
+    }
+
+    // all buffers are width * height rgba in the same row order as the gl textures,
+    // normalDepth holds the first hit normal in xyz and its distance in w
+    std::vector<glm::vec4> denoise(const std::vector<glm::vec4>& color,
+        const std::vector<glm::vec4>& albedo,
+        const std::vector<glm::vec4>& normalDepth,
+        int width, int height) const;
+
+private:
+    int iterations;
+    float colorPhi;
+    float normalPhi;
+    float depthPhi;
+
+    void filterPass(const std::vector<glm::vec4>& input, std::vector<glm::vec4>& output,
+        const std::vector<glm::vec4>& albedo, const std::vector<glm::vec4>& normalDepth,
+        int width, int height, int pass) const;
+};
+
+#endif // DENOISER_H
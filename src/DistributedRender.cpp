@@ -0,0 +1,407 @@
+#include "DistributedRender.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET SocketHandle;
+static const SocketHandle INVALID_HANDLE = INVALID_SOCKET;
+static void closeSocket(SocketHandle handle) { closesocket(handle); }
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketHandle;
+static const SocketHandle INVALID_HANDLE = -1;
+static void closeSocket(SocketHandle handle) { close(handle); }
+#endif
+
+// every message is a header and size bytes of payload
+enum class MessageType : uint32_t {
+    Scene = 1,      // spheres, triangles, bvh nodes, triangle indices
+    Job = 2,        // the DistributedJob
+    Tile = 3,       // a Tile to render
+    TileResult = 4, // the Tile and its width * height dvec4 sums, row by row
+    Done = 5        // no payload, the worker can go
+};
+
+struct MessageHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t size;
+};
+
+static const uint32_t MESSAGE_MAGIC = 0x52445452; // "RTDR"
+
+static bool initSockets()
+{
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }
+    return started;
+#else
+    return true;
+#endif
+}
+
+static bool sendAll(SocketHandle handle, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        int chunk = int(size < (1u << 30) ? size : (1u << 30));
+#ifdef _WIN32
+        int sent = send(handle, bytes, chunk, 0);
+#else
+        // a worker that went away must not kill the coordinator with SIGPIPE
+        int sent = int(send(handle, bytes, size_t(chunk), MSG_NOSIGNAL));
+#endif
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= size_t(sent);
+    }
+    return true;
+}
+
+static bool recvAll(SocketHandle handle, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        int chunk = int(size < (1u << 30) ? size : (1u << 30));
+        int received = int(recv(handle, bytes, chunk, 0));
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= size_t(received);
+    }
+    return true;
+}
+
+static bool sendMessage(SocketHandle handle, MessageType type, const std::vector<char>& payload)
+{
+    MessageHeader header = { MESSAGE_MAGIC, uint32_t(type), payload.size() };
+    return sendAll(handle, &header, sizeof(header)) && sendAll(handle, payload.data(), payload.size());
+}
+
+static bool recvMessage(SocketHandle handle, MessageType& type, std::vector<char>& payload)
+{
+    MessageHeader header;
+    if (!recvAll(handle, &header, sizeof(header)) || header.magic != MESSAGE_MAGIC) {
+        return false;
+    }
+    type = MessageType(header.type);
+    payload.resize(size_t(header.size));
+    return recvAll(handle, payload.data(), payload.size());
+}
+
+template <typename T>
+static void appendValue(std::vector<char>& payload, const T& value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+
+// element count first, then the elements as they are in memory
+template <typename T>
+static void appendVector(std::vector<char>& payload, const std::vector<T>& values)
+{
+    appendValue(payload, uint64_t(values.size()));
+    const char* bytes = reinterpret_cast<const char*>(values.data());
+    payload.insert(payload.end(), bytes, bytes + values.size() * sizeof(T));
+}
+
+// reads appendValue / appendVector data back, ok turns false once anything ran past the end
+struct PayloadReader {
+    const std::vector<char>& payload;
+    size_t offset = 0;
+    bool ok = true;
+
+    explicit PayloadReader(const std::vector<char>& payload) : payload(payload) {}
+
+    template <typename T>
+    T value()
+    {
+        T result = T();
+        if (ok && payload.size() - offset >= sizeof(T)) {
+            std::memcpy(&result, payload.data() + offset, sizeof(T));
+            offset += sizeof(T);
+        } else {
+            ok = false;
+        }
+        return result;
+    }
+
+    template <typename T>
+    std::vector<T> vector()
+    {
+        uint64_t count = value<uint64_t>();
+        if (!ok || count > (payload.size() - offset) / sizeof(T)) {
+            ok = false;
+            return {};
+        }
+        std::vector<T> result(static_cast<size_t>(count));
+        std::memcpy(result.data(), payload.data() + offset, size_t(count) * sizeof(T));
+        offset += size_t(count) * sizeof(T);
+        return result;
+    }
+};
+
+bool runCoordinator(int port, int workerCount, const Scene& scene, const DistributedJob& job,
+    std::vector<glm::dvec4>& accumulation, std::ostream& log)
+{
+    if (!initSockets()) {
+        log << "Could not start sockets" << std::endl;
+        return false;
+    }
+
+    SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_HANDLE) {
+        log << "Could not create a socket" << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(uint16_t(port));
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, workerCount) != 0) {
+        log << "Could not listen on port " << port << std::endl;
+        closeSocket(listener);
+        return false;
+    }
+
+    log << "Waiting for " << workerCount << " workers on port " << port << std::endl;
+    std::vector<SocketHandle> workers;
+    while (int(workers.size()) < workerCount) {
+        SocketHandle worker = accept(listener, NULL, NULL);
+        if (worker == INVALID_HANDLE) {
+            continue;
+        }
+        // tiles and results are single messages, waiting to fill a packet only adds latency
+        int noDelay = 1;
+        setsockopt(worker, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        workers.push_back(worker);
+        log << "Worker " << workers.size() << " connected" << std::endl;
+    }
+    closeSocket(listener);
+
+    // the bvh goes along so the workers do not build it again
+    std::vector<char> scenePayload;
+    appendVector(scenePayload, scene.getSpheres());
+    appendVector(scenePayload, scene.getTriangles());
+    appendVector(scenePayload, scene.getBVHNodes());
+    appendVector(scenePayload, scene.getTriangleIndices());
+    std::vector<char> jobPayload;
+    appendValue(jobPayload, job);
+
+    std::deque<Tile> pending;
+    for (int y = 0; y < job.height; y += job.tileSize) {
+        for (int x = 0; x < job.width; x += job.tileSize) {
+            pending.push_back({ x, y, std::min(x + job.tileSize, job.width), std::min(y + job.tileSize, job.height) });
+        }
+    }
+    const size_t tileCount = pending.size();
+    size_t finished = 0;
+    int inFlight = 0;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    accumulation.assign(size_t(job.width) * job.height, glm::dvec4(0.0));
+    auto start = std::chrono::steady_clock::now();
+
+    auto serve = [&](int id) {
+        SocketHandle worker = workers[id];
+        int tiles = 0;
+        bool connected = sendMessage(worker, MessageType::Scene, scenePayload) && sendMessage(worker, MessageType::Job, jobPayload);
+
+        std::vector<char> payload;
+        while (connected) {
+            Tile tile;
+            {
+                // a tile can still come back from a worker that fails, so only stop once none are out
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return !pending.empty() || inFlight == 0; });
+                if (pending.empty()) {
+                    break;
+                }
+                tile = pending.front();
+                pending.pop_front();
+                inFlight++;
+            }
+
+            payload.clear();
+            appendValue(payload, tile);
+            MessageType type;
+            connected = sendMessage(worker, MessageType::Tile, payload) && recvMessage(worker, type, payload) &&
+                type == MessageType::TileResult;
+
+            PayloadReader reader(payload);
+            Tile returned = reader.value<Tile>();
+            std::vector<glm::dvec4> sums = reader.vector<glm::dvec4>();
+            connected = connected && reader.ok && std::memcmp(&returned, &tile, sizeof(Tile)) == 0 &&
+                sums.size() == size_t(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight--;
+            if (connected) {
+                // sums and counts add up, the coordinator never needs to know how many samples a worker took
+                size_t i = 0;
+                for (int y = tile.y0; y < tile.y1; y++) {
+                    for (int x = tile.x0; x < tile.x1; x++) {
+                        accumulation[size_t(y) * job.width + x] += sums[i++];
+                    }
+                }
+                finished++;
+                tiles++;
+            } else {
+                pending.push_back(tile);
+                log << "Worker " << id + 1 << " dropped out, its tile goes to the others" << std::endl;
+            }
+            changed.notify_all();
+        }
+
+        if (connected) {
+            sendMessage(worker, MessageType::Done, {});
+        }
+        closeSocket(worker);
+        std::lock_guard<std::mutex> lock(mutex);
+        log << "Worker " << id + 1 << " rendered " << tiles << " tiles" << std::endl;
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workerCount; i++) {
+        threads.emplace_back(serve, i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (finished < tileCount) {
+        log << "Only " << finished << " of " << tileCount << " tiles were rendered" << std::endl;
+        return false;
+    }
+    log << tileCount << " tiles from " << workerCount << " workers in " << seconds << " s" << std::endl;
+    return true;
+}
+
+bool runWorker(const std::string& host, int port, const std::function<void(CpuRayTracer&)>& configure,
+    std::ostream& log)
+{
+    if (!initSockets()) {
+        log << "Could not start sockets" << std::endl;
+        return false;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = NULL;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        log << "Could not resolve " << host << std::endl;
+        return false;
+    }
+    SocketHandle coordinator = INVALID_HANDLE;
+    for (addrinfo* address = addresses; address != NULL && coordinator == INVALID_HANDLE; address = address->ai_next) {
+        coordinator = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (coordinator != INVALID_HANDLE && connect(coordinator, address->ai_addr, int(address->ai_addrlen)) != 0) {
+            closeSocket(coordinator);
+            coordinator = INVALID_HANDLE;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (coordinator == INVALID_HANDLE) {
+        log << "Could not connect to " << host << ":" << port << std::endl;
+        return false;
+    }
+    int noDelay = 1;
+    setsockopt(coordinator, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+    MessageType type;
+    std::vector<char> payload;
+    Scene scene;
+    DistributedJob job;
+    bool ok = recvMessage(coordinator, type, payload) && type == MessageType::Scene;
+    if (ok) {
+        PayloadReader reader(payload);
+        std::vector<Sphere> spheres = reader.vector<Sphere>();
+        std::vector<Triangle> triangles = reader.vector<Triangle>();
+        std::vector<BVHNode> nodes = reader.vector<BVHNode>();
+        std::vector<int> indices = reader.vector<int>();
+        scene.setSpheres(spheres);
+        scene.setPrebuilt(triangles, nodes, indices);
+        ok = reader.ok && recvMessage(coordinator, type, payload) && type == MessageType::Job;
+    }
+    if (ok) {
+        PayloadReader reader(payload);
+        job = reader.value<DistributedJob>();
+        ok = reader.ok && job.width > 0 && job.height > 0 && job.samples > 0;
+    }
+    if (!ok) {
+        log << "Did not get a scene and job from the coordinator" << std::endl;
+        closeSocket(coordinator);
+        return false;
+    }
+    log << "Rendering " << job.width << "x" << job.height << " with " << job.samples << " samples, "
+        << scene.getTriangles().size() << " triangles" << std::endl;
+
+    CpuRayTracer tracer(job.width, job.height, std::move(scene));
+    tracer.setSamplerType(job.samplerType);
+    configure(tracer);
+
+    int tiles = 0;
+    while ((ok = recvMessage(coordinator, type, payload)) && type == MessageType::Tile) {
+        PayloadReader reader(payload);
+        Tile tile = reader.value<Tile>();
+        if (!reader.ok || tile.x0 < 0 || tile.y0 < 0 || tile.x1 > job.width || tile.y1 > job.height ||
+            tile.x0 >= tile.x1 || tile.y0 >= tile.y1) {
+            ok = false;
+            break;
+        }
+
+        // every tile starts over, so its pixels get the first samples of a local render
+        tracer.resetAccumulation();
+        for (int i = 0; i < job.samples; i++) {
+            tracer.renderRegion(job.camera.position, job.camera.target, job.camera.up, tile);
+        }
+
+        std::vector<glm::dvec4> sums;
+        sums.reserve(size_t(tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+        const std::vector<glm::dvec4>& accumulation = tracer.getAccumulation();
+        for (int y = tile.y0; y < tile.y1; y++) {
+            for (int x = tile.x0; x < tile.x1; x++) {
+                sums.push_back(accumulation[size_t(y) * job.width + x]);
+            }
+        }
+        payload.clear();
+        appendValue(payload, tile);
+        appendVector(payload, sums);
+        if (!sendMessage(coordinator, MessageType::TileResult, payload)) {
+            ok = false;
+            break;
+        }
+        tiles++;
+    }
+    closeSocket(coordinator);
+
+    ok = ok && type == MessageType::Done;
+    log << "Rendered " << tiles << " tiles" << (ok ? "" : ", lost the coordinator") << std::endl;
+    return ok;
+}
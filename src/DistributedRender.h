@@ -0,0 +1,41 @@
+#ifndef DISTRIBUTED_RENDER_H
+#define DISTRIBUTED_RENDER_H
+
+#include "CpuRayTracer.h"
+#include "RayTracer.h"
+#include "Sampler.h"
+#include "Scene.h"
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// one image rendered by a coordinator and its workers
+struct DistributedJob {
+    int width = 800;
+    int height = 600;
+    RenderCamera camera;
+    int samples = 64;
+    SamplerType samplerType = SamplerType::Sobol;
+    // the image goes out in square tiles of this size, small enough that a fast worker
+    // takes more of them than a slow one
+    int tileSize = 64;
+};
+
+// Final frame rendering over tcp. The coordinator waits for workerCount workers to connect,
+// sends each of them the scene with its already built BVH and the job, then deals out tiles
+// as the workers finish them. A worker traces every sample of a tile with CpuRayTracer and
+// sends back the radiance sums and sample counts, which the coordinator adds into accumulation
+// (RayTracer::readAccumulation layout). Pixels get the same samples as in a local render, so
+// the result does not depend on how many workers there were or which tile went where.
+// Tiles of a worker that drops out go back to the others. The scene is sent as raw structs,
+// every process has to be the same build. false when the image could not be finished
+bool runCoordinator(int port, int workerCount, const Scene& scene, const DistributedJob& job,
+    std::vector<glm::dvec4>& accumulation, std::ostream& log);
+
+// connects to a coordinator at host:port and renders tiles until it says the image is done,
+// configure gets the tracer before the first tile (threads, isa, ...). false on connection errors
+bool runWorker(const std::string& host, int port, const std::function<void(CpuRayTracer&)>& configure,
+    std::ostream& log);
+
+#endif // DISTRIBUTED_RENDER_H
@@ -0,0 +1,227 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+GpuProfiler::GpuProfiler()
+    : enabled(false), window(120), current(0), frameNumber(0), stageOpen(false), droppedFrames(0), logJson(false)
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    // the last frames belong in the log too
+    if (log.is_open()) {
+        flush();
+    }
+    for (FrameQueries& frame : frames) {
+        for (Interval& interval : frame.intervals) {
+            glDeleteQueries(2, interval.queries);
+        }
+    }
+}
+
+void GpuProfiler::nextFrame()
+{
+    if (!enabled) {
+        return;
+    }
+    if (stageOpen) {
+        end();
+    }
+
+    frames[current].pending = frames[current].used > 0;
+    current = (current + 1) % FRAMES_IN_FLIGHT;
+
+    // this set was recorded FRAMES_IN_FLIGHT - 1 frames ago and is about to be reused
+    collect(frames[current], false);
+    frames[current].used = 0;
+    frames[current].frame = ++frameNumber;
+}
+
+void GpuProfiler::begin(const std::string& stage)
+{
+    if (!enabled) {
+        return;
+    }
+    if (stageOpen) {
+        end();
+    }
+
+    FrameQueries& frame = frames[current];
+    if (frame.used == frame.intervals.size()) {
+        Interval interval;
+        glGenQueries(2, interval.queries);
+        frame.intervals.push_back(interval);
+    }
+    Interval& interval = frame.intervals[frame.used];
+    interval.stage = stageIndex(stage);
+    glQueryCounter(interval.queries[0], GL_TIMESTAMP);
+    stageOpen = true;
+}
+
+void GpuProfiler::end()
+{
+    if (!enabled || !stageOpen) {
+        return;
+    }
+    FrameQueries& frame = frames[current];
+    glQueryCounter(frame.intervals[frame.used].queries[1], GL_TIMESTAMP);
+    frame.used++;
+    stageOpen = false;
+}
+
+int GpuProfiler::stageIndex(const std::string& stage)
+{
+    auto found = std::find(stageNames.begin(), stageNames.end(), stage);
+    if (found != stageNames.end()) {
+        return int(found - stageNames.begin());
+    }
+    stageNames.push_back(stage);
+    history.emplace_back();
+    return int(stageNames.size()) - 1;
+}
+
+void GpuProfiler::flush()
+{
+    if (stageOpen) {
+        end();
+    }
+    frames[current].pending = frames[current].used > 0;
+    // oldest first, the one being recorded is the newest
+    for (int i = 1; i <= FRAMES_IN_FLIGHT; i++) {
+        FrameQueries& frame = frames[(current + i) % FRAMES_IN_FLIGHT];
+        collect(frame, true);
+        frame.used = 0;
+    }
+}
+
+void GpuProfiler::collect(FrameQueries& frame, bool wait)
+{
+    if (!frame.pending) {
+        return;
+    }
+    frame.pending = false;
+
+    // the last stamp of the frame finishes last
+    GLint available = 0;
+    if (!wait) {
+        glGetQueryObjectiv(frame.intervals[frame.used - 1].queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (!wait && !available) {
+        droppedFrames++;
+        return;
+    }
+
+    std::vector<double> stageMs(stageNames.size(), 0.0);
+    std::vector<bool> seen(stageNames.size(), false);
+    for (size_t i = 0; i < frame.used; i++) {
+        const Interval& interval = frame.intervals[i];
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(interval.queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(interval.queries[1], GL_QUERY_RESULT, &end);
+        stageMs[interval.stage] += end > start ? double(end - start) * 1e-6 : 0.0;
+        seen[interval.stage] = true;
+    }
+
+    bool first = true;
+    if (log.is_open() && logJson) {
+        log << "{\"frame\":" << frame.frame << ",\"stages\":{";
+    }
+    for (size_t stage = 0; stage < stageNames.size(); stage++) {
+        if (!seen[stage]) {
+            continue;
+        }
+        history[stage].push_back(stageMs[stage]);
+        while (int(history[stage].size()) > window) {
+            history[stage].pop_front();
+        }
+
+        if (log.is_open()) {
+            if (logJson) {
+                log << (first ? "" : ",") << "\"" << stageNames[stage] << "\":" << stageMs[stage];
+            } else {
+                log << frame.frame << "," << stageNames[stage] << "," << stageMs[stage] << "\n";
+            }
+        }
+        first = false;
+    }
+    if (log.is_open() && logJson) {
+        log << "}}\n";
+    }
+}
+
+std::vector<GpuProfiler::StageStats> GpuProfiler::getStats() const
+{
+    std::vector<StageStats> stats;
+    for (size_t stage = 0; stage < stageNames.size(); stage++) {
+        std::vector<double> sorted(history[stage].begin(), history[stage].end());
+        if (sorted.empty()) {
+            continue;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) { return sorted[size_t(p * double(sorted.size() - 1) + 0.5)]; };
+
+        StageStats stat;
+        stat.name = stageNames[stage];
+        stat.samples = int(sorted.size());
+        stat.averageMs = 0.0;
+        for (double ms : sorted) {
+            stat.averageMs += ms;
+        }
+        stat.averageMs /= double(sorted.size());
+        stat.medianMs = percentile(0.5);
+        stat.p95Ms = percentile(0.95);
+        stat.p99Ms = percentile(0.99);
+        stat.maxMs = sorted.back();
+        stats.push_back(stat);
+    }
+    return stats;
+}
+
+double GpuProfiler::getAverageMs(const std::string& stage) const
+{
+    auto found = std::find(stageNames.begin(), stageNames.end(), stage);
+    if (found == stageNames.end()) {
+        return 0.0;
+    }
+    const std::deque<double>& samples = history[found - stageNames.begin()];
+    if (samples.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double ms : samples) {
+        sum += ms;
+    }
+    return sum / double(samples.size());
+}
+
+void GpuProfiler::printStats(std::ostream& out) const
+{
+    out << "gpu stage       avg ms    p50 ms    p95 ms    p99 ms    max ms  frames" << std::endl;
+    for (const StageStats& stat : getStats()) {
+        out << std::left << std::setw(12) << stat.name << std::right << std::fixed << std::setprecision(3)
+            << std::setw(10) << stat.averageMs << std::setw(10) << stat.medianMs << std::setw(10) << stat.p95Ms
+            << std::setw(10) << stat.p99Ms << std::setw(10) << stat.maxMs << std::setw(8) << stat.samples << std::endl;
+    }
+    out.unsetf(std::ios::fixed);
+    out << std::setprecision(6);
+    if (droppedFrames > 0) {
+        out << droppedFrames << " frames dropped, their results were not ready in time" << std::endl;
+    }
+}
+
+bool GpuProfiler::openLog(const std::string& path)
+{
+    log.open(path);
+    if (!log) {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+    logJson = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (!logJson) {
+        log << "frame,stage,ms\n";
+    }
+    return true;
+}
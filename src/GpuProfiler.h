@@ -0,0 +1,96 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+#include <deque>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Gpu time of the stages of a frame (uploads, trace, denoise, ...) from timestamp queries.
+// Every stage gets a pair of GL_TIMESTAMP queries instead of a GL_TIME_ELAPSED one, some drivers
+// (llvmpipe among them) report 0 elapsed time around compute work. Queries of the last
+// FRAMES_IN_FLIGHT frames are kept apart and a frame is only read back when its set comes
+// around again, by then the gpu has long finished it so nothing stalls. A frame whose results
+// are still not there is dropped rather than waited for
+class GpuProfiler {
+public:
+    struct StageStats {
+        std::string name;
+        int samples;
+        double averageMs;
+        double medianMs;
+        double p95Ms;
+        double p99Ms;
+        double maxMs;
+    };
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    // off by default, begin and end do nothing then
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+    // how many of the latest frames the averages and percentiles cover
+    void setWindow(int frames) { window = frames < 1 ? 1 : frames; }
+
+    // closes the frame being recorded and starts the next one
+    void nextFrame();
+    // stages do not nest, a stage that comes up several times in a frame is summed
+    void begin(const std::string& stage);
+    void end();
+
+    // waits for the frames still in flight and collects them, they would otherwise only be read
+    // once their query sets come around again. call it before reading the stats at the end of a run
+    void flush();
+
+    // in the order the stages first showed up
+    std::vector<StageStats> getStats() const;
+    // 0 for a stage without results yet
+    double getAverageMs(const std::string& stage) const;
+    int getDroppedFrames() const { return droppedFrames; }
+    void printStats(std::ostream& out) const;
+
+    // every collected frame is appended to the file, a .json path gets one json object per line
+    // ({"frame":12,"stages":{"trace":3.1,...}}), anything else csv rows of frame,stage,ms
+    bool openLog(const std::string& path);
+
+private:
+    static const int FRAMES_IN_FLIGHT = 3;
+
+    struct Interval {
+        int stage;
+        GLuint queries[2];
+    };
+
+    struct FrameQueries {
+        long long frame = 0;
+        std::vector<Interval> intervals;
+        size_t used = 0;
+        bool pending = false;
+    };
+
+    bool enabled;
+    int window;
+    FrameQueries frames[FRAMES_IN_FLIGHT];
+    int current;
+    long long frameNumber;
+    bool stageOpen;
+    int droppedFrames;
+
+    std::vector<std::string> stageNames;
+    std::vector<std::deque<double>> history;
+
+    std::ofstream log;
+    bool logJson;
+
+    int stageIndex(const std::string& stage);
+    // wait blocks until the results are there instead of dropping the frame
+    void collect(FrameQueries& frame, bool wait);
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+};
+
+#endif // GPU_PROFILER_H
@@ -0,0 +1,24 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+// gl 4.3 core context without a window for servers and ci. uses EGL, surfaceless when Mesa
+// offers it so llvmpipe works without X or a gpu. windows has no EGL, there it is a hidden
+// glfw window, which still needs a driver that does 4.3
+class HeadlessContext {
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    // makes the context current and loads the gl functions, false if no 4.3 context could be made
+    bool create();
+    void destroy();
+    bool isValid() const { return valid; }
+
+private:
+    bool valid;
+    // EGLDisplay and EGLContext, or the hidden GLFWwindow on windows
+    void* display;
+    void* context;
+};
+
+#endif // HEADLESS_CONTEXT_H
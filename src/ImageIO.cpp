@@ -0,0 +1,146 @@
+#include "ImageIO.h"
+#include "ToneMap.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+static bool hasExtension(const std::string& path, const std::string& extension)
+{
+    if (path.size() < extension.size()) return false;
+    std::string tail = path.substr(path.size() - extension.size());
+    std::transform(tail.begin(), tail.end(), tail.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return tail == extension;
+}
+
+bool writeImage(const std::string& path, int width, int height, const std::vector<glm::vec4>& pixels)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+
+    if (hasExtension(path, ".pfm")) {
+        // pfm stores its rows bottom up already, the negative scale marks little endian
+        file << "PF\n" << width << " " << height << "\n-1.0\n";
+        std::vector<float> row(size_t(width) * 3);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const glm::vec4& pixel = pixels[size_t(y) * width + x];
+                row[x * 3 + 0] = pixel.r;
+                row[x * 3 + 1] = pixel.g;
+                row[x * 3 + 2] = pixel.b;
+            }
+            file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+        }
+    } else {
+        // ppm goes top down
+        file << "P6\n" << width << " " << height << "\n255\n";
+        std::vector<unsigned char> row(size_t(width) * 3);
+        for (int y = height - 1; y >= 0; y--) {
+            for (int x = 0; x < width; x++) {
+                glm::vec3 color = glm::clamp(glm::vec3(pixels[size_t(y) * width + x]), 0.0f, 1.0f);
+                for (int c = 0; c < 3; c++) {
+                    row[x * 3 + c] = static_cast<unsigned char>(color[c] * 255.0f + 0.5f);
+                }
+            }
+            file.write(reinterpret_cast<const char*>(row.data()), row.size());
+        }
+    }
+    return bool(file);
+}
+
+bool writeRadiance(const std::string& path, int width, int height, const std::vector<glm::vec4>& radiance)
+{
+    if (hasExtension(path, ".pfm")) {
+        return writeImage(path, width, height, radiance);
+    }
+    std::vector<glm::vec4> image(radiance.size());
+    for (size_t i = 0; i < radiance.size(); i++) {
+        image[i] = glm::vec4(toneMap(glm::vec3(radiance[i]), 0.0f, ToneMapper::None, 1.0f), 1.0f);
+    }
+    return writeImage(path, width, height, image);
+}
+
+bool writeDebugView(const std::string& path, int width, int height, const std::vector<glm::vec4>& costs, float scale)
+{
+    if (hasExtension(path, ".pfm")) {
+        return writeImage(path, width, height, costs);
+    }
+    std::vector<glm::vec4> image(costs.size());
+    for (size_t i = 0; i < costs.size(); i++) {
+        image[i] = glm::vec4(heatColor(costs[i].x / scale), 1.0f);
+    }
+    return writeImage(path, width, height, image);
+}
+
+bool readImage(const std::string& path, int& width, int& height, std::vector<glm::vec4>& pixels)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "Could not open " << path << std::endl;
+        return false;
+    }
+
+    std::string magic;
+    file >> magic >> width >> height;
+    bool pfm = magic == "PF" || magic == "Pf";
+    if (!file || (!pfm && magic != "P6") || width <= 0 || height <= 0) {
+        std::cout << path << " is not a pfm or binary ppm" << std::endl;
+        return false;
+    }
+
+    if (pfm) {
+        float scale = 0.0f;
+        file >> scale;
+        // one whitespace character ends the header
+        file.get();
+        int channels = magic == "PF" ? 3 : 1;
+        std::vector<float> row(size_t(width) * channels);
+        pixels.assign(size_t(width) * height, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        for (int y = 0; y < height; y++) {
+            file.read(reinterpret_cast<char*>(row.data()), row.size() * sizeof(float));
+            if (scale > 0.0f) {
+                // big endian, every float gets its bytes turned around
+                for (float& value : row) {
+                    uint32_t bits;
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    bits = (bits >> 24) | ((bits >> 8) & 0xff00u) | ((bits << 8) & 0xff0000u) | (bits << 24);
+                    std::memcpy(&value, &bits, sizeof(bits));
+                }
+            }
+            for (int x = 0; x < width; x++) {
+                glm::vec4& pixel = pixels[size_t(y) * width + x];
+                for (int c = 0; c < 3; c++) {
+                    pixel[c] = row[size_t(x) * channels + (channels == 3 ? c : 0)];
+                }
+            }
+        }
+    } else {
+        int maxValue = 0;
+        file >> maxValue;
+        file.get();
+        if (maxValue != 255) {
+            std::cout << path << " is not an 8 bit ppm" << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> row(size_t(width) * 3);
+        pixels.assign(size_t(width) * height, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        for (int y = height - 1; y >= 0; y--) {
+            file.read(reinterpret_cast<char*>(row.data()), row.size());
+            for (int x = 0; x < width; x++) {
+                for (int c = 0; c < 3; c++) {
+                    pixels[size_t(y) * width + x][c] = float(row[x * 3 + c]) / 255.0f;
+                }
+            }
+        }
+    }
+
+    if (!file) {
+        std::cout << path << " is cut short" << std::endl;
+        return false;
+    }
+    return true;
+}
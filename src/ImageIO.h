@@ -0,0 +1,25 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// pixels are width * height rgba, row 0 is the bottom row like in the gl textures and the
+// accumulation. a .pfm path keeps the floats as they are (linear radiance for comparisons),
+// anything else is written as a binary 8 bit .ppm of the clamped values
+bool writeImage(const std::string& path, int width, int height, const std::vector<glm::vec4>& pixels);
+
+// linear radiance as it comes out of averageAccumulation, a .pfm gets it unchanged and
+// any other format the same clamp the window shows
+bool writeRadiance(const std::string& path, int width, int height, const std::vector<glm::vec4>& radiance);
+
+// an image of a RayTracer debug view (the cost in x), a .pfm keeps the costs and any other
+// format gets the heat ramp the window shows, with scale as full red
+bool writeDebugView(const std::string& path, int width, int height, const std::vector<glm::vec4>& costs, float scale);
+
+// reads back what writeImage writes, a .pfm (rgb or grey, either byte order) as floats and a
+// binary .ppm as values in [0, 1]. prints what is wrong and returns false for anything else
+bool readImage(const std::string& path, int& width, int& height, std::vector<glm::vec4>& pixels);
+
+#endif // IMAGE_IO_H
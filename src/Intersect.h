@@ -0,0 +1,81 @@
+#ifndef INTERSECT_H
+#define INTERSECT_H
+
+#include "Scene.h"
+#include <cmath>
+#include <utility>
+
+// the single ray tests of CpuRayTracer, line by line copies of the ones in shaders/scene.glsl.
+// in a header of their own so the microbenchmarks time exactly what the tracer runs
+
+inline bool intersectSphere(const glm::vec3& origin, const glm::vec3& dir, const Sphere& sphere, float tMin, float tMax, float& t, glm::vec3& normal) {
+    glm::vec3 oc = origin - sphere.center;
+    float b = glm::dot(oc, dir);
+    float c = glm::dot(oc, oc) - sphere.radius * sphere.radius;
+    float h = b * b - c;
+    if (h < 0.0f) return false;
+    h = std::sqrt(h);
+    t = -b - h;
+    if (t < tMin || t > tMax) {
+        t = -b + h;
+        if (t < tMin || t > tMax) return false;
+    }
+
+    glm::vec3 hitPoint = origin + dir * t;
+    normal = glm::normalize(hitPoint - sphere.center);
+    return true;
+}
+
+inline bool intersectTriangle(const glm::vec3& origin, const glm::vec3& dir, const Triangle& triangle, float tMin, float tMax, float& t) {
+    const float epsilon = 1e-7f;
+
+    glm::vec3 edge1 = triangle.v1 - triangle.v0;
+    glm::vec3 edge2 = triangle.v2 - triangle.v0;
+
+    glm::vec3 pvec = glm::cross(dir, edge2);
+    float det = glm::dot(edge1, pvec);
+
+    if (det > -epsilon && det < epsilon)
+        return false;
+
+    float invDet = 1.0f / det;
+    glm::vec3 tvec = origin - triangle.v0;
+    float u = invDet * glm::dot(tvec, pvec);
+
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    glm::vec3 qvec = glm::cross(tvec, edge1);
+    float v = invDet * glm::dot(dir, qvec);
+
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = invDet * glm::dot(edge2, qvec);
+
+    if (t < tMin || t > tMax)
+        return false;
+
+    return true;
+}
+
+inline bool intersectAABB(const glm::vec3& origin, const glm::vec3& dir, const AABB& aabb, float tMin, float tMax) {
+    for (int i = 0; i < 3; i++) {
+        float invD = 1.0f / dir[i];
+        float t0 = (aabb.min[i] - origin[i]) * invD;
+        float t1 = (aabb.max[i] - origin[i]) * invD;
+
+        if (invD < 0.0f) {
+            std::swap(t0, t1);
+        }
+
+        // written out instead of std::max so a nan slab (0 * inf) keeps the old bound like glsl max does
+        tMin = t0 > tMin ? t0 : tMin;
+        tMax = t1 < tMax ? t1 : tMax;
+
+        if (tMax < tMin) return false;
+    }
+    return true;
+}
+
+#endif // INTERSECT_H
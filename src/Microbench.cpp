@@ -0,0 +1,294 @@
+#include "Microbench.h"
+#include "Benchmark.h"
+#include "Intersect.h"
+#include "Scene.h"
+#include "WideBVH.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// rays per distribution and primitives per block, the block stays in l1 so the numbers are the
+// kernel and not the memory behind it
+#define MICROBENCH_RAYS 4096
+#define MICROBENCH_PRIMITIVES 64
+// every measurement repeats its loop for at least this long
+#define MICROBENCH_SECONDS 0.25
+
+struct BenchRay {
+    glm::vec3 origin;
+    glm::vec3 dir;
+};
+
+struct RaySet {
+    const char* name;
+    std::vector<BenchRay> rays;
+};
+
+static glm::vec3 randomInBox(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    return glm::vec3(unit(random), unit(random), unit(random));
+}
+
+static glm::vec3 randomDirection(std::mt19937& random)
+{
+    std::normal_distribution<float> normal;
+    glm::vec3 dir(normal(random), normal(random), normal(random));
+    return glm::length(dir) > 1e-6f ? glm::normalize(dir) : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+// all three aimed at the [-1, 1] box the primitives sit in
+static std::vector<RaySet> makeRaySets(std::mt19937& random)
+{
+    std::vector<RaySet> sets(3);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // a 64x64 camera looking down z, neighbours differ by a fraction of a degree
+    sets[0].name = "coherent";
+    int side = int(std::sqrt(double(MICROBENCH_RAYS)));
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            glm::vec3 target(-1.2f + 2.4f * (x + 0.5f) / side, -1.2f + 2.4f * (y + 0.5f) / side, 0.0f);
+            glm::vec3 origin(0.0f, 0.0f, -4.0f);
+            sets[0].rays.push_back({ origin, glm::normalize(target - origin) });
+        }
+    }
+
+    sets[1].name = "incoherent";
+    for (int i = 0; i < MICROBENCH_RAYS; i++) {
+        glm::vec3 origin = randomDirection(random) * 4.0f;
+        sets[1].rays.push_back({ origin, glm::normalize(randomInBox(random) - origin) });
+    }
+
+    // in a coordinate plane give or take a thousandth, a quarter of them exactly in it so the
+    // slab test sees its 0 * inf case
+    sets[2].name = "grazing";
+    for (int i = 0; i < MICROBENCH_RAYS; i++) {
+        int axis = i % 3;
+        float angle = 2.0f * 3.14159265f * unit(random);
+        glm::vec3 dir(0.0f);
+        dir[(axis + 1) % 3] = std::cos(angle);
+        dir[(axis + 2) % 3] = std::sin(angle);
+        dir[axis] = i % 4 == 0 ? 0.0f : (unit(random) - 0.5f) * 2e-3f;
+        dir = glm::normalize(dir);
+        glm::vec3 target = randomInBox(random);
+        sets[2].rays.push_back({ target - dir * 4.0f, dir });
+    }
+    return sets;
+}
+
+// half of them lie in a coordinate plane like the walls and floors of the scenes do
+static std::vector<Triangle> makeTriangles(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> size(0.2f, 0.6f);
+    std::vector<Triangle> triangles;
+    for (int i = 0; i < MICROBENCH_PRIMITIVES; i++) {
+        Triangle tri;
+        tri.v0 = randomInBox(random);
+        if (i % 2 == 0) {
+            int axis = (i / 2) % 3;
+            tri.v1 = tri.v0;
+            tri.v2 = tri.v0;
+            tri.v1[(axis + 1) % 3] += size(random);
+            tri.v2[(axis + 2) % 3] += size(random);
+        } else {
+            tri.v1 = tri.v0 + randomDirection(random) * size(random);
+            tri.v2 = tri.v0 + randomDirection(random) * size(random);
+        }
+        tri.normal = glm::normalize(glm::cross(tri.v1 - tri.v0, tri.v2 - tri.v0));
+        tri.material = { glm::vec3(0.8f), 0 };
+        triangles.push_back(tri);
+    }
+    return triangles;
+}
+
+static std::vector<AABB> makeBoxes(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> size(0.1f, 0.5f);
+    std::vector<AABB> boxes;
+    for (int i = 0; i < MICROBENCH_PRIMITIVES; i++) {
+        glm::vec3 min = randomInBox(random);
+        boxes.push_back(AABB(min, min + glm::vec3(size(random), size(random), size(random))));
+    }
+    return boxes;
+}
+
+static std::vector<Sphere> makeSpheres(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> radius(0.05f, 0.3f);
+    std::vector<Sphere> spheres;
+    for (int i = 0; i < MICROBENCH_PRIMITIVES; i++) {
+        spheres.push_back({ randomInBox(random), radius(random), { glm::vec3(0.8f), 0 } });
+    }
+    return spheres;
+}
+
+// every ray against every primitive until MICROBENCH_SECONDS are up, test returns whether it hit
+template <typename Primitive, typename Test>
+static void timeKernel(std::ostream& out, const char* kernel, const RaySet& set, const std::vector<Primitive>& primitives, Test test)
+{
+    long long tests = 0;
+    long long hits = 0;
+    double seconds = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    while (seconds < MICROBENCH_SECONDS) {
+        for (const BenchRay& ray : set.rays) {
+            for (const Primitive& primitive : primitives) {
+                hits += test(ray, primitive);
+            }
+        }
+        tests += (long long)(set.rays.size() * primitives.size());
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    out << std::left << std::setw(12) << kernel << std::setw(12) << set.name << std::right << std::fixed
+        << std::setprecision(2) << std::setw(10) << seconds * 1e9 / double(tests) << " ns" << std::setw(10)
+        << double(tests) / seconds * 1e-6 << " M/s" << std::setw(9) << 100.0 * double(hits) / double(tests) << " % hit" << std::endl;
+}
+
+// the rays of the [-1, 1] box stretched over the bounds, directions stretch along so grazing
+// rays stay grazing
+static std::vector<BenchRay> fitRays(const std::vector<BenchRay>& rays, const AABB& bounds)
+{
+    glm::vec3 center = bounds.center();
+    glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+    std::vector<BenchRay> fitted;
+    for (const BenchRay& ray : rays) {
+        fitted.push_back({ center + ray.origin * half, glm::normalize(ray.dir * half) });
+    }
+    return fitted;
+}
+
+// the best of a few runs, a builder's first run also pays for the allocations
+template <typename Build>
+static double bestOf(int runs, Build build)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        build();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+void runMicrobench(std::ostream& out)
+{
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    std::mt19937 random(1234);
+    std::vector<RaySet> sets = makeRaySets(random);
+    std::vector<Triangle> triangles = makeTriangles(random);
+    std::vector<AABB> boxes = makeBoxes(random);
+    std::vector<Sphere> spheres = makeSpheres(random);
+
+    out << "kernel      rays          per test     tests    hit rate" << std::endl;
+    for (const RaySet& set : sets) {
+        timeKernel(out, "triangle", set, triangles, [](const BenchRay& ray, const Triangle& tri) {
+            float t;
+            return intersectTriangle(ray.origin, ray.dir, tri, 0.001f, 1e30f, t);
+        });
+        timeKernel(out, "aabb", set, boxes, [](const BenchRay& ray, const AABB& box) {
+            return intersectAABB(ray.origin, ray.dir, box, 0.001f, 1e30f);
+        });
+        timeKernel(out, "sphere", set, spheres, [](const BenchRay& ray, const Sphere& sphere) {
+            float t;
+            glm::vec3 normal;
+            return intersectSphere(ray.origin, ray.dir, sphere, 0.001f, 1e30f, t, normal);
+        });
+    }
+
+    // the builders and the tracer print their progress, which has no place inside a timing
+    std::ostringstream muted;
+    std::streambuf* console = std::cout.rdbuf(muted.rdbuf());
+
+    Scene bunny;
+    bool haveBunny = bunny.loadOBJ("bunny.obj");
+    if (haveBunny) {
+        bunny.buildBVH();
+    }
+    std::vector<Triangle> grid = syntheticTriangles(200000);
+
+    std::cout.rdbuf(console);
+
+    const SimdIsa isas[] = { SimdIsa::Scalar, SimdIsa::Sse, SimdIsa::Avx2, SimdIsa::Avx512 };
+    if (haveBunny) {
+        out << std::endl << "wide bvh traversal of bunny.obj, " << bunny.getTriangles().size() << " triangles" << std::endl;
+        for (SimdIsa isa : isas) {
+            if (!isSimdIsaSupported(isa)) {
+                continue;
+            }
+            WideBVH wide;
+            std::cout.rdbuf(muted.rdbuf());
+            wide.build(bunny, isa);
+            std::cout.rdbuf(console);
+
+            for (const RaySet& set : sets) {
+                std::vector<BenchRay> rays = fitRays(set.rays, bunny.getBVHNodes()[0].bounds);
+                long long traced = 0;
+                long long hits = 0;
+                double seconds = 0.0;
+                auto start = std::chrono::steady_clock::now();
+                while (seconds < MICROBENCH_SECONDS) {
+                    for (const BenchRay& ray : rays) {
+                        float closestT;
+                        int hitTriangle;
+                        hits += wide.intersect(ray.origin, ray.dir, 0.001f, 1e30f, closestT, hitTriangle);
+                    }
+                    traced += (long long)rays.size();
+                    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                }
+                out << std::left << std::setw(8) << simdIsaName(isa) << "bvh" << std::setw(4) << wide.getWidth()
+                    << std::setw(12) << set.name << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+                    << double(traced) / seconds * 1e-6 << " Mrays/s" << std::setw(9) << 100.0 * double(hits) / double(traced)
+                    << " % hit" << std::endl;
+            }
+        }
+    } else {
+        out << "bunny.obj not found, no traversal or bunny builds" << std::endl;
+    }
+
+    out << std::endl << "builder     scene                   ms   Mtris/s" << std::endl;
+    struct BuildScene {
+        const char* name;
+        const std::vector<Triangle>* triangles;
+    };
+    std::vector<BuildScene> buildScenes;
+    if (haveBunny) {
+        buildScenes.push_back({ "bunny.obj", &bunny.getTriangles() });
+    }
+    buildScenes.push_back({ "grid 200k", &grid });
+    for (const BuildScene& buildScene : buildScenes) {
+        double triangleCount = double(buildScene.triangles->size());
+        Scene scene;
+        std::cout.rdbuf(muted.rdbuf());
+        double binaryMs = bestOf(3, [&]() { scene.setTriangles(*buildScene.triangles); });
+        std::cout.rdbuf(console);
+        out << std::left << std::setw(12) << "binary" << std::setw(16) << buildScene.name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(10) << binaryMs << std::setw(10) << triangleCount / binaryMs * 1e-3 << std::endl;
+
+        // the collapse only depends on the width, sse stands for 4 and avx2 for 8
+        const SimdIsa wideIsas[] = { SimdIsa::Sse, SimdIsa::Avx2 };
+        for (SimdIsa isa : wideIsas) {
+            if (!isSimdIsaSupported(isa)) {
+                continue;
+            }
+            WideBVH wide;
+            std::cout.rdbuf(muted.rdbuf());
+            double wideMs = bestOf(3, [&]() { wide.build(scene, isa); });
+            std::cout.rdbuf(console);
+            std::string name = "wide" + std::to_string(wide.getWidth());
+            out << std::left << std::setw(12) << name << std::setw(16) << buildScene.name << std::right << std::fixed
+                << std::setprecision(2) << std::setw(10) << wideMs << std::setw(10) << triangleCount / wideMs * 1e-3 << std::endl;
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,18 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <ostream>
+
+// Times the cpu kernels on their own, away from the renderer, so a change to one of them can
+// be checked in isolation:
+//  - intersectTriangle, intersectAABB and intersectSphere (Intersect.h), every ray against a
+//    block of primitives that fits the l1 cache, in ns per test with the hit rate
+//  - WideBVH traversal of the bunny for every isa this cpu has, in Mrays/s
+//  - the binary BVH builder (Scene::buildBVH) and the WideBVH collapse on the bunny and a
+//    synthetic grid, in ms and Mtriangles/s
+// rays come in three kinds: coherent camera rays from one point, incoherent ones from random
+// points in random directions, and grazing ones that run almost parallel to the coordinate
+// planes, where walls, floors and every box face lie
+void runMicrobench(std::ostream& out);
+
+#endif // MICROBENCH_H
@@ -0,0 +1,137 @@
+#include "OfflineRenderer.h"
+#include <chrono>
+#include <iostream>
+
+OfflineRenderer::OfflineRenderer(int width, int height, Scene scene, bool forceCpu)
+    : width(width), height(height), rayTracer(nullptr), cpuRayTracer(nullptr), checkpointInterval(60.0)
+{
+    if (!forceCpu && context.create()) {
+        std::cout << "Rendering offscreen on " << glGetString(GL_RENDERER) << std::endl;
+        rayTracer = new RayTracer(GLuint(width), GLuint(height), std::move(scene));
+        rayTracer->setAdaptiveSampling(false);
+        rayTracer->setTemporalReprojection(false);
+        rayTracer->setDenoise(false);
+        return;
+    }
+
+    if (!forceCpu) {
+        std::cout << "No OpenGL 4.3 context, falling back to the cpu" << std::endl;
+    }
+    cpuRayTracer = new CpuRayTracer(width, height, std::move(scene));
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+    // the gl objects have to go before the context
+    delete rayTracer;
+    delete cpuRayTracer;
+    context.destroy();
+}
+
+std::vector<glm::dvec4> OfflineRenderer::render(const RenderCamera& camera, int samples, const std::string& checkpointPath)
+{
+    if (checkpointPath.empty() || !resume(camera, samples, checkpointPath)) {
+        if (rayTracer) {
+            rayTracer->resetAccumulation();
+        } else {
+            cpuRayTracer->resetAccumulation();
+        }
+    }
+
+    auto lastSave = std::chrono::steady_clock::now();
+    int frames = rayTracer ? rayTracer->getFrameCount() : cpuRayTracer->getFrameCount();
+    for (int i = frames; i < samples; i++) {
+        if (rayTracer) {
+            rayTracer->render(camera.position, camera.target, camera.up);
+        } else {
+            cpuRayTracer->render(camera.position, camera.target, camera.up);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (!checkpointPath.empty() && i + 1 < samples && std::chrono::duration<double>(now - lastSave).count() >= checkpointInterval) {
+            // only the read back happens here, the file is written while the next frames trace
+            checkpointWriter.save(checkpointPath, makeCheckpoint(camera));
+            lastSave = now;
+        }
+    }
+
+    // a write still going could otherwise bring the file back after the caller removed it
+    checkpointWriter.wait();
+    return rayTracer ? rayTracer->readAccumulation() : cpuRayTracer->getAccumulation();
+}
+
+Checkpoint OfflineRenderer::makeCheckpoint(const RenderCamera& camera) const
+{
+    Checkpoint checkpoint;
+    checkpoint.width = width;
+    checkpoint.height = height;
+    checkpoint.camera = camera;
+    if (rayTracer) {
+        checkpoint.frameCount = rayTracer->getFrameCount();
+        checkpoint.samplerType = rayTracer->getSamplerType();
+        checkpoint.triangleCount = int(rayTracer->getScene().getTriangles().size());
+        checkpoint.sceneChecksum = sceneChecksum(rayTracer->getScene());
+        checkpoint.accumulation = rayTracer->readAccumulation();
+    } else {
+        checkpoint.frameCount = cpuRayTracer->getFrameCount();
+        checkpoint.samplerType = cpuRayTracer->getSamplerType();
+        checkpoint.triangleCount = int(cpuRayTracer->getScene().getTriangles().size());
+        checkpoint.sceneChecksum = sceneChecksum(cpuRayTracer->getScene());
+        checkpoint.accumulation = cpuRayTracer->getAccumulation();
+    }
+    checkpoint.albedo = getAlbedo();
+    checkpoint.normalDepth = getNormalDepth();
+    return checkpoint;
+}
+
+// false when there is nothing usable to resume from, the render then starts over
+bool OfflineRenderer::resume(const RenderCamera& camera, int samples, const std::string& checkpointPath)
+{
+    Checkpoint checkpoint;
+    if (!readCheckpoint(checkpointPath, checkpoint)) {
+        return false;
+    }
+
+    SamplerType samplerType = rayTracer ? rayTracer->getSamplerType() : cpuRayTracer->getSamplerType();
+    const Scene& scene = rayTracer ? rayTracer->getScene() : cpuRayTracer->getScene();
+    if (checkpoint.triangleCount != int(scene.getTriangles().size()) || checkpoint.sceneChecksum != sceneChecksum(scene)) {
+        std::cout << checkpointPath << " was made from a different scene, starting over" << std::endl;
+        return false;
+    }
+    if (checkpoint.width != width || checkpoint.height != height || checkpoint.samplerType != samplerType ||
+        checkpoint.camera.position != camera.position || checkpoint.camera.target != camera.target ||
+        checkpoint.camera.up != camera.up || checkpoint.frameCount > samples) {
+        std::cout << checkpointPath << " belongs to a different render, starting over" << std::endl;
+        return false;
+    }
+
+    if (rayTracer) {
+        rayTracer->restoreAccumulation(camera.position, camera.target, camera.up, checkpoint.frameCount,
+            checkpoint.accumulation, checkpoint.albedo, checkpoint.normalDepth);
+    } else {
+        cpuRayTracer->restoreAccumulation(camera.position, camera.target, camera.up, checkpoint.frameCount,
+            checkpoint.accumulation, checkpoint.albedo, checkpoint.normalDepth);
+    }
+    std::cout << "Resuming from " << checkpointPath << " at " << checkpoint.frameCount << " of " << samples << " samples" << std::endl;
+    return true;
+}
+
+std::vector<glm::vec4> OfflineRenderer::readTexture(GLuint texture) const
+{
+    std::vector<glm::vec4> pixels(size_t(width) * height);
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return pixels;
+}
+
+std::vector<glm::vec4> OfflineRenderer::getAlbedo() const
+{
+    return rayTracer ? readTexture(rayTracer->getAlbedoTexture()) : cpuRayTracer->getAlbedo();
+}
+
+std::vector<glm::vec4> OfflineRenderer::getNormalDepth() const
+{
+    return rayTracer ? readTexture(rayTracer->getNormalDepthTexture()) : cpuRayTracer->getNormalDepth();
+}
@@ -0,0 +1,59 @@
+#ifndef OFFLINE_RENDERER_H
+#define OFFLINE_RENDERER_H
+
+#include "Checkpoint.h"
+#include "HeadlessContext.h"
+#include "RayTracer.h"
+#include "CpuRayTracer.h"
+#include "Scene.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// renders without a window: on the gpu through a HeadlessContext when one can be made,
+// on the cpu otherwise (or when forceCpu is set). samples are taken as asked, so adaptive
+// sampling, reprojection and the gpu denoiser are off, turn them on through getRayTracer()
+class OfflineRenderer {
+public:
+    OfflineRenderer(int width, int height, Scene scene, bool forceCpu);
+    ~OfflineRenderer();
+
+    bool onGpu() const { return rayTracer != nullptr; }
+    // exactly one of the two is set
+    RayTracer* getRayTracer() { return rayTracer; }
+    CpuRayTracer* getCpuRayTracer() { return cpuRayTracer; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // starts over and traces samples frames, returns the sums and counts like RayTracer::readAccumulation.
+    // with a checkpoint path the render picks up from that file when it holds the same image and
+    // camera, and saves its progress there every checkpoint interval in the background. the file is
+    // left behind, remove it once the result is safe
+    std::vector<glm::dvec4> render(const RenderCamera& camera, int samples, const std::string& checkpointPath = "");
+
+    void setCheckpointInterval(double seconds) { checkpointInterval = seconds; }
+    double getCheckpointInterval() const { return checkpointInterval; }
+
+    // first hit features of the last render for the cpu Denoiser, same layout as CpuRayTracer's
+    std::vector<glm::vec4> getAlbedo() const;
+    std::vector<glm::vec4> getNormalDepth() const;
+
+private:
+    int width;
+    int height;
+    HeadlessContext context;
+    RayTracer* rayTracer;
+    CpuRayTracer* cpuRayTracer;
+    double checkpointInterval;
+    CheckpointWriter checkpointWriter;
+
+    OfflineRenderer(const OfflineRenderer&) = delete;
+    OfflineRenderer& operator=(const OfflineRenderer&) = delete;
+
+    std::vector<glm::vec4> readTexture(GLuint texture) const;
+    Checkpoint makeCheckpoint(const RenderCamera& camera) const;
+    bool resume(const RenderCamera& camera, int samples, const std::string& checkpointPath);
+};
+
+#endif // OFFLINE_RENDERER_H
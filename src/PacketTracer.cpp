@@ -0,0 +1,50 @@
+#include "PacketTracer.h"
+
+int packetWidth(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::Avx2: return 8;
+    case SimdIsa::Avx512: return 16;
+    default: return 4;
+    }
+}
+
+PacketTracer::PacketTracer()
+    : isa(detectSimdIsa())
+{
+}
+
+void PacketTracer::setScene(const Scene& scene) {
+    const std::vector<BVHNode>& nodes = scene.getBVHNodes();
+    const std::vector<int>& indices = scene.getTriangleIndices();
+    const std::vector<Triangle>& sceneTriangles = scene.getTriangles();
+
+    nodeBounds.clear();
+    nodeLinks.clear();
+    for (const BVHNode& node : nodes) {
+        nodeBounds.insert(nodeBounds.end(), { node.bounds.min.x, node.bounds.min.y, node.bounds.min.z,
+            node.bounds.max.x, node.bounds.max.y, node.bounds.max.z });
+        nodeLinks.insert(nodeLinks.end(), { node.leftChild, node.rightChild, node.firstTriIndex, node.triCount });
+    }
+
+    // triangles in leaf order so a leaf reads one contiguous block
+    triangles.clear();
+    triangleIndices = indices;
+    for (int index : indices) {
+        const Triangle& tri = sceneTriangles[index];
+        triangles.insert(triangles.end(), { tri.v0.x, tri.v0.y, tri.v0.z, tri.v1.x, tri.v1.y, tri.v1.z, tri.v2.x, tri.v2.y, tri.v2.z });
+    }
+}
+
+void PacketTracer::setIsa(SimdIsa newIsa) {
+    isa = isSimdIsaSupported(newIsa) ? newIsa : detectSimdIsa();
+}
+
+void PacketTracer::intersect(RayPacket& packet, TraversalCounts* counts) const {
+    PacketBVH bvh = { nodeBounds.data(), nodeLinks.data(), int(nodeBounds.size() / 6), triangles.data(), triangleIndices.data(), counts };
+    switch (isa) {
+    case SimdIsa::Sse: intersectPacketSse(bvh, packet); break;
+    case SimdIsa::Avx2: intersectPacketAvx2(bvh, packet); break;
+    case SimdIsa::Avx512: intersectPacketAvx512(bvh, packet); break;
+    default: intersectPacketScalar(bvh, packet); break;
+    }
+}
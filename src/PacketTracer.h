@@ -0,0 +1,71 @@
+#ifndef PACKET_TRACER_H
+#define PACKET_TRACER_H
+
+#include "Scene.h"
+#include "Simd.h"
+#include <vector>
+
+#define MAX_PACKET_WIDTH 16
+
+// rays per packet, the lanes of one register
+int packetWidth(SimdIsa isa);
+
+// structure of arrays so every field loads straight into a register,
+// lanes past the packet width or with their bit clear in activeMask are ignored
+struct RayPacket {
+    float originX[MAX_PACKET_WIDTH];
+    float originY[MAX_PACKET_WIDTH];
+    float originZ[MAX_PACKET_WIDTH];
+    float dirX[MAX_PACKET_WIDTH];
+    float dirY[MAX_PACKET_WIDTH];
+    float dirZ[MAX_PACKET_WIDTH];
+    float tMin;
+    float tMax[MAX_PACKET_WIDTH];   // in: farthest hit that counts, out: distance of the closest triangle
+    int hitTriangle[MAX_PACKET_WIDTH]; // out: index into Scene::getTriangles, -1 if nothing was closer than tMax
+    int activeMask;
+};
+
+// raw views of PacketTracer's arrays, the kernels are compiled with different target flags
+// so they only get plain pointers and no std or glm code that could be shared between them
+struct PacketBVH {
+    const float* nodeBounds;     // min xyz, max xyz
+    const int* nodeLinks;        // leftChild, rightChild, firstTriIndex, triCount
+    int nodeCount;
+    const float* triangles;      // v0, v1, v2 in bvh leaf order
+    const int* triangleIndices;  // scene triangle of each entry above
+    TraversalCounts* counts;     // null when nothing is counted
+};
+
+void intersectPacketScalar(const PacketBVH& bvh, RayPacket& packet);
+void intersectPacketSse(const PacketBVH& bvh, RayPacket& packet);
+void intersectPacketAvx2(const PacketBVH& bvh, RayPacket& packet);
+void intersectPacketAvx512(const PacketBVH& bvh, RayPacket& packet);
+
+// Traces packets of coherent rays (the camera rays of a few neighbouring pixels) through the
+// scene's BVH together, a node is visited once for the whole packet instead of once per ray.
+// every lane does the same float math as CpuRayTracer's single ray traversal and keeps its own
+// node mask, so each ray ends up with exactly the hit the single ray code would have found
+class PacketTracer {
+public:
+    PacketTracer();
+
+    // copies the BVH into the flat layout the kernels read
+    void setScene(const Scene& scene);
+
+    // unsupported isas fall back to the best one the cpu has
+    void setIsa(SimdIsa newIsa);
+    SimdIsa getIsa() const { return isa; }
+    int getWidth() const { return packetWidth(isa); }
+
+    // counts, when given, gets the work of the whole packet added to it
+    void intersect(RayPacket& packet, TraversalCounts* counts = nullptr) const;
+
+private:
+    SimdIsa isa;
+    std::vector<float> nodeBounds;
+    std::vector<int> nodeLinks;
+    std::vector<float> triangles;
+    std::vector<int> triangleIndices;
+};
+
+#endif // PACKET_TRACER_H
@@ -0,0 +1,55 @@
+#include "RayCounters.h"
+#include <iomanip>
+
+uint64_t RayCounters::totalRays() const {
+    uint64_t total = 0;
+    for (uint64_t count : rays) {
+        total += count;
+    }
+    return total;
+}
+
+RayCounters& RayCounters::operator+=(const RayCounters& other) {
+    for (int i = 0; i < RAY_COUNTER_BOUNCES; i++) {
+        rays[i] += other.rays[i];
+    }
+    traversal.nodeVisits += other.traversal.nodeVisits;
+    traversal.aabbTests += other.traversal.aabbTests;
+    traversal.triangleTests += other.traversal.triangleTests;
+    return *this;
+}
+
+RayCounters RayCounters::operator-(const RayCounters& earlier) const {
+    RayCounters difference;
+    for (int i = 0; i < RAY_COUNTER_BOUNCES; i++) {
+        difference.rays[i] = rays[i] - earlier.rays[i];
+    }
+    difference.traversal.nodeVisits = traversal.nodeVisits - earlier.traversal.nodeVisits;
+    difference.traversal.aabbTests = traversal.aabbTests - earlier.traversal.aabbTests;
+    difference.traversal.triangleTests = traversal.triangleTests - earlier.traversal.triangleTests;
+    return difference;
+}
+
+void printRayCounters(std::ostream& out, const RayCounters& counters, double seconds) {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    uint64_t total = counters.totalRays();
+    double perRay = total > 0 ? 1.0 / double(total) : 0.0;
+    out << std::fixed << std::setprecision(2) << total << " rays";
+    if (seconds > 0.0) {
+        out << " in " << seconds * 1000.0 << " ms, " << double(total) / seconds * 1e-6 << " Mrays/s";
+    }
+    out << ", per ray " << double(counters.traversal.nodeVisits) * perRay << " nodes, "
+        << double(counters.traversal.aabbTests) * perRay << " box tests, "
+        << double(counters.traversal.triangleTests) * perRay << " triangle tests" << std::endl;
+
+    out << "  rays by bounce:";
+    for (int i = 0; i < RAY_COUNTER_BOUNCES; i++) {
+        out << " " << counters.rays[i];
+    }
+    out << "+" << std::endl;
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,27 @@
+#ifndef RAY_COUNTERS_H
+#define RAY_COUNTERS_H
+
+#include "Simd.h"
+#include <cstdint>
+#include <ostream>
+
+// same as RAY_COUNTER_BOUNCES in shaders/scene.glsl
+#define RAY_COUNTER_BOUNCES 8
+
+// rays traced and what their traversal cost, counted by RayTracer and CpuRayTracer when
+// setRayCounters is on. a ray is one closest hit query, so a path of n bounces is n rays
+struct RayCounters {
+    // by bounce, the last entry also holds every deeper one
+    uint64_t rays[RAY_COUNTER_BOUNCES] = {};
+    TraversalCounts traversal = {};
+
+    uint64_t totalRays() const;
+    RayCounters& operator+=(const RayCounters& other);
+    // the work done between two readings of the running totals
+    RayCounters operator-(const RayCounters& earlier) const;
+};
+
+// rays per bounce, per ray costs and, when seconds > 0, the rate
+void printRayCounters(std::ostream& out, const RayCounters& counters, double seconds);
+
+#endif // RAY_COUNTERS_H
@@ -2,147 +2,50 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
-#include <numeric>
-#include <chrono>
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
 
 RayTracer::RayTracer(GLuint width, GLuint height)
-    : width(width), height(height), frameCount(0), prevCamPos(0.0f), prevCamTarget(0.0f), prevCamUp(0.0f), spheresChanged(true), trianglesChanged(true), bvhChanged(true)
+    : RayTracer(width, height, Scene::defaultScene())
 {
-    spheres = {
-        //{{0.0f, 0.0f, 0.0f}, 0.5f, {1.0f, 0.0f, 0.0f}, 0}, // Lambertian
-        // {{2.0f, 2.0f, 0.0f}, 1.0f, {10.0f, 10.0f, 10.0f}, 1}, // Light (bright white)
-        //{{0.0f, -100.5f, 0.0f}, 100.0f, {0.5f, 0.5f, 0.5f}, 0} // Lambertian
-    };
-
-    Triangle leftWall1, leftWall2, rightWall1, rightWall2, backWall1, backWall2, floor1, floor2, ceiling1, ceiling2, frontWall1, frontWall2;
-    
-    //// Left wall (x = -3, normal pointing right) - 2 triangles
-    //leftWall1.v0 = glm::vec3(-3.0f, -3.0f, -3.0f);
-    //leftWall1.v1 = glm::vec3(-3.0f, 3.0f, -3.0f);
-    //leftWall1.v2 = glm::vec3(-3.0f, 3.0f, 3.0f);
-    //leftWall1.normal = glm::vec3(1.0f, 0.0f, 0.0f);
-    //leftWall1.material = {{0.8f, 0.2f, 0.2f}, 0}; // Red, Lambertian
-    //
-    //leftWall2.v0 = glm::vec3(-3.0f, -3.0f, -3.0f);
-    //leftWall2.v1 = glm::vec3(-3.0f, 3.0f, 3.0f);
-    //leftWall2.v2 = glm::vec3(-3.0f, -3.0f, 3.0f);
-    //leftWall2.normal = glm::vec3(1.0f, 0.0f, 0.0f);
-    //leftWall2.material = {{0.8f, 0.2f, 0.2f}, 0}; // Red, Lambertian
-    //
-    //// Right wall (x = 3, normal pointing left) - 2 triangles
-    //rightWall1.v0 = glm::vec3(3.0f, -3.0f, -3.0f);
-    //rightWall1.v1 = glm::vec3(3.0f, 3.0f, 3.0f);
-    //rightWall1.v2 = glm::vec3(3.0f, 3.0f, -3.0f);
-    //rightWall1.normal = glm::vec3(-1.0f, 0.0f, 0.0f);
-    //rightWall1.material = {{0.2f, 0.8f, 0.2f}, 0}; // Green, Lambertian
-    //
-    //rightWall2.v0 = glm::vec3(3.0f, -3.0f, -3.0f);
-    //rightWall2.v1 = glm::vec3(3.0f, -3.0f, 3.0f);
-    //rightWall2.v2 = glm::vec3(3.0f, 3.0f, 3.0f);
-    //rightWall2.normal = glm::vec3(-1.0f, 0.0f, 0.0f);
-    //rightWall2.material = {{0.2f, 0.8f, 0.2f}, 0}; // Green, Lambertian
-    
-    // Back wall (z = -3, normal pointing forward) - 2 triangles
-    backWall1.v0 = glm::vec3(-3.0f, -3.0f, -3.0f);
-    backWall1.v1 = glm::vec3(3.0f, 3.0f, -3.0f);
-    backWall1.v2 = glm::vec3(-3.0f, 3.0f, -3.0f);
-    backWall1.normal = glm::vec3(0.0f, 0.0f, 1.0f);
-    backWall1.material = {{0.2f, 0.2f, 0.8f}, 0}; // Blue, Lambertian
-    
-    backWall2.v0 = glm::vec3(-3.0f, -3.0f, -3.0f);
-    backWall2.v1 = glm::vec3(3.0f, -3.0f, -3.0f);
-    backWall2.v2 = glm::vec3(3.0f, 3.0f, -3.0f);
-    backWall2.normal = glm::vec3(0.0f, 0.0f, 1.0f);
-    backWall2.material = {{0.2f, 0.2f, 0.8f}, 0}; // Blue, Lambertian
-    
-    // Floor (y = -3, normal pointing up) - 2 triangles
-    floor1.v0 = glm::vec3(-3.0f, -3.0f, -3.0f);
-    floor1.v1 = glm::vec3(-3.0f, -3.0f, 3.0f);  // Swapped v1 and v2
-    floor1.v2 = glm::vec3(3.0f, -3.0f, 3.0f);   // Swapped v1 and v2
-    floor1.normal = glm::vec3(0.0f, 1.0f, 0.0f); // Pointing up
-    floor1.material = {{0.8f, 0.8f, 0.8f}, 0}; // Gray, Lambertian
-    
-    floor2.v0 = glm::vec3(-3.0f, -3.0f, -3.0f);
-    floor2.v1 = glm::vec3(3.0f, -3.0f, 3.0f);   // Swapped v1 and v2
-    floor2.v2 = glm::vec3(3.0f, -3.0f, -3.0f);  // Swapped v1 and v2
-    floor2.normal = glm::vec3(0.0f, 1.0f, 0.0f); // Pointing up
-    floor2.material = {{0.8f, 0.8f, 0.8f}, 0}; // Gray, Lambertian
-    
-    // Ceiling (y = 3, normal pointing down) - 2 triangles
-    ceiling1.v0 = glm::vec3(-3.0f, 3.0f, -3.0f);
-    ceiling1.v1 = glm::vec3(3.0f, 3.0f, 3.0f);  // Swapped v1 and v2
-    ceiling1.v2 = glm::vec3(-3.0f, 3.0f, 3.0f); // Swapped v1 and v2
-    ceiling1.normal = glm::vec3(0.0f, -1.0f, 0.0f); // Pointing down
-    ceiling1.material = {{0.8f, 0.8f, 0.8f}, 0}; // Gray, Lambertian
-    
-    ceiling2.v0 = glm::vec3(-3.0f, 3.0f, -3.0f);
-    ceiling2.v1 = glm::vec3(3.0f, 3.0f, -3.0f);  // Back to original
-    ceiling2.v2 = glm::vec3(3.0f, 3.0f, 3.0f); // Back to original
-    ceiling2.normal = glm::vec3(0.0f, -1.0f, 0.0f); // Pointing down
-    ceiling2.material = {{0.8f, 0.8f, 0.8f}, 0}; // Gray, Lambertian
-
-    //Triangle light1, light2;
-    //light1.v0 = glm::vec3(-1.0f, 2.99f, -1.0f);
-    //light1.v1 = glm::vec3(1.0f, 2.99f, -1.0f);
-    //light1.v2 = glm::vec3(1.0f, 2.99f, 1.0f);
-    //light1.normal = glm::vec3(0.0f, -1.0f, 0.0f); // Pointing down
-    //light1.material = {{10.0f, 10.0f, 10.0f}, 1}; // Bright white, Light
-
-    //light2.v0 = glm::vec3(-1.0f, 2.99f, -1.0f);
-    //light2.v1 = glm::vec3(1.0f, 2.99f, 1.0f);
-    //light2.v2 = glm::vec3(-1.0f, 2.99f, 1.0f);
-    //light2.normal = glm::vec3(0.0f, -1.0f, 0.0f); // Pointing down
-    //light2.material = {{10.0f, 10.0f, 10.0f}, 1}; // Bright white, Light
-
-    //// Front wall (z = 3, normal pointing backward) - 2 triangles
-    //frontWall1.v0 = glm::vec3(-3.0f, -3.0f, 3.0f);
-    //frontWall1.v1 = glm::vec3(-3.0f, 3.0f, 3.0f);
-    //frontWall1.v2 = glm::vec3(3.0f, 3.0f, 3.0f);
-    //frontWall1.normal = glm::vec3(0.0f, 0.0f, -1.0f);
-    //frontWall1.material = {{0.8f, 0.8f, 0.2f}, 0}; // Yellow, Lambertian
-
-    //frontWall2.v0 = glm::vec3(-3.0f, -3.0f, 3.0f);
-    //frontWall2.v1 = glm::vec3(3.0f, 3.0f, 3.0f);
-    //frontWall2.v2 = glm::vec3(3.0f, -3.0f, 3.0f);
-    //frontWall2.normal = glm::vec3(0.0f, 0.0f, -1.0f);
-    //frontWall2.material = {{0.8f, 0.8f, 0.2f}, 0}; // Yellow, Lambertian
-
-    triangles = {
-        //leftWall1, leftWall2,
-        //rightWall1, rightWall2,
-        backWall1, backWall2,
-        floor1, floor2,
-        ceiling1, ceiling2,
-        //frontWall1, frontWall2,
-        //light1, light2
-    };
-
-    for (auto& tri : triangles) {
-		tri.v0.y += 3.0f;
-		tri.v1.y += 3.0f;
-		tri.v2.y += 3.0f;
-	}
-
-    // Load the cube OBJ file
-    Material cubeMaterial = {{0.5f, 0.8f, 0.3f}, 0};
-    if (!loadOBJ("cube.OBJ", cubeMaterial)) {
-        std::cerr << "Failed to load cube.OBJ" << std::endl;
-    }
-
-    Material bunnyMaterial = { {0.9f,0.0f, 0.0f}, 0 };
-    if (!loadOBJ("bunny.obj", bunnyMaterial)) {
-        std::cerr << "Failed to load bunny.obj" << std::endl;
-    }
+}
 
+RayTracer::RayTracer(GLuint width, GLuint height, Scene newScene)
+    : scene(std::move(newScene)), width(width), height(height),
+      exposure(0.0f), toneMapper(ToneMapper::None), gamma(1.0f),
+      adaptiveSampling(true), adaptiveThreshold(0.02f), adaptiveMinSamples(16),
+      denoise(true), denoiseIterations(5), denoiseColorPhi(0.5f), denoiseNormalPhi(0.1f), denoiseDepthPhi(0.1f),
+      temporalReprojection(true), maxHistory(64), reprojectDepthTolerance(0.05f),
+      traceKernel(TraceKernel::Megakernel), persistentGroups(512),
+      persistentIterationCap(0), persistentChecked(false),
+      viewsTexture(0), viewFrameCount(0), debugView(DebugView::Off), debugScale(1.0f),
+      progressive(false), progressiveTargetMs(1000.0f / 30.0f), renderScale(1), traceScale(1),
+      rayCounting(false), nextRayCounterCopy(0), rayCounterSequence(0), rayCounterTotalsSequence(0),
+      frameReprojecting(false), frameActiveList(false), frameCamPos(0.0f), frameCamTarget(0.0f), frameCamUp(0.0f),
+      frameBudgetMs(0.0f), nextTile(0), tileCount(0), budgetListLength(0), budgetMsPerPixel(0.0), nextBudgetTiming(0),
+      frameCount(0), samplerType(SamplerType::Sobol), prevCamPos(0.0f), prevCamTarget(0.0f), prevCamUp(0.0f),
+      spheresChanged(true), trianglesChanged(true), bvhChanged(true)
+{
     setupTexture();
     setupShader();
+    setupAccumulation();
     setupSSBO();
     setupTrianglesSSBO();
+    setupAdaptiveSampling();
+    setupDenoiser();
+    setupHistory();
+    setupWavefront();
+    setupPersistent();
+    setupMultiview();
+    setupRayCounters();
+    for (BudgetTiming& timing : budgetTimings) {
+        glGenQueries(2, timing.queries);
+        timing.pending = false;
+        timing.pixels = 0;
+    }
     
     // bvh only after all triangles are loaded
-    buildBVH();
+    if (scene.getBVHNodes().empty()) {
+        scene.buildBVH();
+    }
     setupBVHSSBO();
     setupBVHIndicesSSBO();
 }
@@ -150,63 +53,329 @@ RayTracer::RayTracer(GLuint width, GLuint height)
 RayTracer::~RayTracer()
 {
     glDeleteTextures(1, &outputTexture);
+    glDeleteBuffers(1, &accumulationSSBO);
+    glDeleteBuffers(1, &historyAccumulationSSBO);
     glDeleteBuffers(1, &ssbo);
     glDeleteBuffers(1, &trianglesSSBO);
     glDeleteBuffers(1, &bvhSSBO);
     glDeleteBuffers(1, &bvhIndicesSSBO);
+    glDeleteTextures(1, &momentsTexture);
+    glDeleteBuffers(1, &activePixelsSSBO);
+    glDeleteBuffers(1, &adaptiveDispatchSSBO);
+    glDeleteTextures(1, &albedoTexture);
+    glDeleteTextures(1, &normalDepthTexture);
+    glDeleteTextures(2, denoiseTextures);
+    glDeleteTextures(3, historyTextures);
+    glDeleteBuffers(1, &pathStatesSSBO);
+    glDeleteBuffers(1, &rayQueuesSSBO);
+    glDeleteBuffers(1, &wavefrontCountersSSBO);
+    glDeleteBuffers(1, &workPoolSSBO);
+    glDeleteTextures(1, &viewsTexture);
+    glDeleteBuffers(1, &viewCamerasSSBO);
+    glDeleteBuffers(1, &viewAccumulationSSBO);
+    glDeleteBuffers(1, &rayCountersSSBO);
+    for (RayCounterCopy& copy : rayCounterCopies) {
+        glDeleteBuffers(1, &copy.buffer);
+        if (copy.fence) {
+            glDeleteSync(copy.fence);
+        }
+    }
+    for (BudgetTiming& timing : budgetTimings) {
+        glDeleteQueries(2, timing.queries);
+    }
     delete computeShader;
+    delete tonemapShader;
+    delete adaptiveShader;
+    delete denoiseShader;
+    delete wavefrontGenerateShader;
+    delete wavefrontExtendShader;
+    delete wavefrontShadeShader;
+    delete wavefrontAccumulateShader;
+    delete persistentShader;
+    delete multiviewShader;
 }
 
 void RayTracer::render(const glm::vec3& cameraPos,
     const glm::vec3& cameraTarget,
     const glm::vec3& cameraUp)
 {
-    // Reset frame count if camera has moved
-    if (cameraPos != prevCamPos || cameraTarget != prevCamTarget || cameraUp != prevCamUp) {
+    profiler.nextFrame();
+
+    // a budgeted frame that is still missing tiles is carried on, unless the camera moved since it started
+    // the debug views are part of the megakernel only
+    TraceKernel kernel = debugView == DebugView::Off ? traceKernel : TraceKernel::Megakernel;
+    bool budgeted = frameBudgetMs > 0.0f && kernel == TraceKernel::Megakernel;
+    bool continuing = budgeted && nextTile > 0 &&
+        cameraPos == frameCamPos && cameraTarget == frameCamTarget && cameraUp == frameCamUp;
+    if (!continuing) {
+        beginFrame(cameraPos, cameraTarget, cameraUp, budgeted);
+    }
+
+    // the denoiser reuses slot 5, so the history goes back in before every trace
+    glBindImageTexture(5, historyTextures[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(6, historyTextures[1], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+    glBindImageTexture(7, historyTextures[2], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+
+    bool frameDone = true;
+    profiler.begin("trace");
+    if (budgeted) {
+        computeShader->use();
+        setTraceUniforms(computeShader, cameraPos, cameraTarget, cameraUp, frameActiveList, frameReprojecting);
+        frameDone = traceBudgeted();
+    } else if (kernel == TraceKernel::Wavefront) {
+        Shader* passes[4] = { wavefrontGenerateShader, wavefrontExtendShader, wavefrontShadeShader, wavefrontAccumulateShader };
+        for (Shader* pass : passes) {
+            pass->use();
+            setTraceUniforms(pass, cameraPos, cameraTarget, cameraUp, frameActiveList, frameReprojecting);
+        }
+        traceWavefront(frameActiveList);
+    } else if (kernel == TraceKernel::Persistent) {
+        persistentShader->use();
+        setTraceUniforms(persistentShader, cameraPos, cameraTarget, cameraUp, frameActiveList, frameReprojecting);
+        tracePersistent();
+    } else {
+        computeShader->use();
+        setTraceUniforms(computeShader, cameraPos, cameraTarget, cameraUp, frameActiveList, frameReprojecting);
+        dispatchPixels(computeShader, frameActiveList);
+    }
+
+	// this is the barrier to ensure that the writes to the accumulation and feature images have finished before we use them
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    profiler.end();
+
+    // a pixel holds either all of its samples of this frame or none, so the partial frame can be shown
+    updateDisplay();
+
+    if (frameDone) {
+        prevCamPos = cameraPos;
+        prevCamTarget = cameraTarget;
+        prevCamUp = cameraUp;
+        nextTile = 0;
+        frameCount++;
+    }
+
+    if (rayCounting) {
+        copyRayCounters();
+    }
+}
+
+// everything decided once per frame: reset or reprojection, the progressive level and the
+// pixels to trace. a budgeted frame also gets its tiles here
+void RayTracer::beginFrame(const glm::vec3& cameraPos, const glm::vec3& cameraTarget, const glm::vec3& cameraUp, bool budgeted)
+{
+    bool cameraMoved = cameraPos != prevCamPos || cameraTarget != prevCamTarget || cameraUp != prevCamUp;
+    int scale = progressive ? pickRenderScale(cameraMoved) : 1;
+    // samples of different block sizes do not mix, and a coarse frame is no history to reproject
+    bool scaleChanged = scale != traceScale;
+    traceScale = scale;
+
+    // When the camera moved the accumulation is either reprojected into the new view
+    // or, with reprojection off (or nothing accumulated yet), thrown away
+    bool reprojecting = false;
+    if (cameraMoved) {
+        if (temporalReprojection && debugView == DebugView::Off && frameCount > 0 && scale == 1 && !scaleChanged) {
+            profiler.begin("history");
+            saveHistory();
+            profiler.end();
+            reprojecting = true;
+        } else {
+            frameCount = 0;
+        }
+    } else if (scaleChanged) {
         frameCount = 0;
     }
-    prevCamPos = cameraPos;
-    prevCamTarget = cameraTarget;
-    prevCamUp = cameraUp;
 
+    profiler.begin("upload");
     updateSSBO();
     updateTrianglesSSBO();
     updateBVHSSBO();
     updateBVHIndicesSSBO();
+    profiler.end();
+
+    // every pixel needs a few samples before its variance means anything,
+    // after that only the pixels left in the active list get traced
+    // the reprojection frame has to touch every pixel to carry its history over
+    bool traceActiveList = adaptiveSampling && debugView == DebugView::Off && !reprojecting && scale == 1 && frameCount >= adaptiveMinSamples;
+    if (traceActiveList) {
+        profiler.begin("adaptive");
+        compactActivePixels();
+        profiler.end();
+    }
 
-    computeShader->use();
+    frameReprojecting = reprojecting;
+    frameActiveList = traceActiveList;
+    frameCamPos = cameraPos;
+    frameCamTarget = cameraTarget;
+    frameCamUp = cameraUp;
+    nextTile = 0;
+    tileCount = 0;
 
-    // passing camera uniforms
-    computeShader->setVec3("camPos", cameraPos);
-    computeShader->setVec3("camTarget", cameraTarget);
-    computeShader->setVec3("camUp", cameraUp);
-    computeShader->setInt("frameCount", frameCount);
-    computeShader->setVec2("resolution", glm::vec2(width, height));
-    computeShader->setInt("numSpheres", static_cast<int>(spheres.size()));
-    computeShader->setInt("numTriangles", static_cast<int>(triangles.size()));
-    computeShader->setInt("numBVHNodes", static_cast<int>(bvhNodes.size()));
+    if (!budgeted) {
+        return;
+    }
+    if (traceActiveList) {
+        // the tiles of the list need its length on the cpu, one small read back per frame
+        GLuint activeCount = 0;
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, adaptiveDispatchSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(GLuint), sizeof(GLuint), &activeCount);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        budgetListLength = int(activeCount);
+        tileCount = (budgetListLength + BUDGET_TILE_PIXELS - 1) / BUDGET_TILE_PIXELS;
+    } else {
+        tileCount = budgetTilesX() * budgetTilesY();
+    }
+}
 
-    // we are going to make worker groups with each of them containing 16 * 16 threads as defined in the compute shader
-    // we are adding 15 to ensure we round up when the dimensions are not multiples of 16
-	// coordinates (id's which we are using as pixel cordinates) are not in the bounds of the size of the screen then the shader will automatically discard them
-	// as written in the compute shader
-    GLuint workGroupsX = (width + 15) / 16;
-    GLuint workGroupsY = (height + 15) / 16;
-    computeShader->dispatchCompute(workGroupsX, workGroupsY, 1);
+// the image (in blocks at the progressive level) in squares of BUDGET_TILE_SIDE^2 groups
+int RayTracer::budgetTilesX() const
+{
+    int side = BUDGET_TILE_SIDE * 16;
+    return ((int(width) + traceScale - 1) / traceScale + side - 1) / side;
+}
+
+int RayTracer::budgetTilesY() const
+{
+    int side = BUDGET_TILE_SIDE * 16;
+    return ((int(height) + traceScale - 1) / traceScale + side - 1) / side;
+}
+
+// issues tiles of the current frame until the next one would go over the budget, at least
+// one per call so a frame always finishes. true once the frame is complete
+bool RayTracer::traceBudgeted()
+{
+    collectBudgetTimings();
+    // without an estimate yet a single tile is issued to get one
+    double budgetPixels = budgetMsPerPixel > 0.0 ? frameBudgetMs / budgetMsPerPixel : 0.0;
+
+    // a query whose result is still outstanding is not reused, that call just goes untimed
+    BudgetTiming& timing = budgetTimings[nextBudgetTiming];
+    bool timed = !timing.pending;
+    if (timed) {
+        glQueryCounter(timing.queries[0], GL_TIMESTAMP);
+    }
+
+    long long pixels = 0;
+    while (nextTile < tileCount) {
+        if (pixels > 0 && double(pixels + BUDGET_TILE_PIXELS) > budgetPixels) {
+            break;
+        }
+        if (frameActiveList) {
+            int first = nextTile * BUDGET_TILE_PIXELS;
+            computeShader->setIVec2("dispatchOffset", glm::ivec2(first, 0));
+            computeShader->dispatchCompute(GLuint(BUDGET_TILE_SIDE * BUDGET_TILE_SIDE), 1, 1);
+            int remaining = budgetListLength - first;
+            pixels += remaining < BUDGET_TILE_PIXELS ? remaining : BUDGET_TILE_PIXELS;
+        } else {
+            int side = BUDGET_TILE_SIDE * 16;
+            glm::ivec2 offset(nextTile % budgetTilesX() * side, nextTile / budgetTilesX() * side);
+            computeShader->setIVec2("dispatchOffset", offset);
+            computeShader->dispatchCompute(GLuint(BUDGET_TILE_SIDE), GLuint(BUDGET_TILE_SIDE), 1);
+            glm::ivec2 blocks = (glm::ivec2(width, height) + traceScale - 1) / traceScale;
+            glm::ivec2 size = glm::min(blocks - offset, glm::ivec2(side));
+            pixels += size.x * size.y;
+        }
+        nextTile++;
+    }
+
+    if (timed) {
+        glQueryCounter(timing.queries[1], GL_TIMESTAMP);
+        timing.pending = true;
+        timing.pixels = pixels;
+        nextBudgetTiming = (nextBudgetTiming + 1) % BUDGET_TIMINGS;
+    }
+    return nextTile >= tileCount;
+}
+
+// folds the finished timer queries into the cost estimate without waiting for the others
+void RayTracer::collectBudgetTimings()
+{
+    for (BudgetTiming& timing : budgetTimings) {
+        if (!timing.pending) {
+            continue;
+        }
+        GLint available = 0;
+        // the end stamp finishes last
+        glGetQueryObjectiv(timing.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;
+        }
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(timing.queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(timing.queries[1], GL_QUERY_RESULT, &end);
+        timing.pending = false;
+        if (timing.pixels == 0 || end <= start) {
+            continue;
+        }
+
+        // smoothed, tiles over the sky are much cheaper than the ones over the bunny
+        double msPerPixel = double(end - start) * 1e-6 / double(timing.pixels);
+        budgetMsPerPixel = budgetMsPerPixel > 0.0 ? budgetMsPerPixel * 0.7 + msPerPixel * 0.3 : msPerPixel;
+    }
+}
 
-	// this is the barrier to ensure that the writes to the image have finished before we use it
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+// uniforms of the passes that trace pixels, the shader has to be in use
+void RayTracer::setTraceUniforms(const Shader* shader, const glm::vec3& cameraPos, const glm::vec3& cameraTarget,
+    const glm::vec3& cameraUp, bool traceActiveList, bool reprojecting) const
+{
+    // passing camera uniforms
+    shader->setVec3("camPos", cameraPos);
+    shader->setVec3("camTarget", cameraTarget);
+    shader->setVec3("camUp", cameraUp);
+    shader->setInt("frameCount", frameCount);
+    shader->setVec2("resolution", glm::vec2(width, height));
+    shader->setInt("numSpheres", static_cast<int>(scene.getSpheres().size()));
+    shader->setInt("numTriangles", static_cast<int>(scene.getTriangles().size()));
+    shader->setInt("numBVHNodes", static_cast<int>(scene.getBVHNodes().size()));
+    shader->setInt("renderScale", traceScale);
+    shader->setIVec2("dispatchOffset", glm::ivec2(0));
+    shader->setInt("useActiveList", traceActiveList ? 1 : 0);
+    shader->setInt("samplerType", static_cast<int>(samplerType));
+    shader->setInt("reproject", reprojecting ? 1 : 0);
+    shader->setVec3("prevCamPos", prevCamPos);
+    shader->setVec3("prevCamTarget", prevCamTarget);
+    shader->setVec3("prevCamUp", prevCamUp);
+    shader->setFloat("maxHistory", float(maxHistory));
+    shader->setFloat("depthTolerance", reprojectDepthTolerance);
+    shader->setInt("rayCounters", rayCounting ? 1 : 0);
+    shader->setInt("debugView", static_cast<int>(debugView));
+}
 
-    frameCount++;
+// one invocation per pixel traced this frame, either the whole image or the active list
+void RayTracer::dispatchPixels(const Shader* shader, bool traceActiveList) const
+{
+    if (traceActiveList) {
+        // group count was written by the compaction pass so nothing has to be read back
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, adaptiveDispatchSSBO);
+        shader->dispatchComputeIndirect(0);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    } else {
+        // we are going to make worker groups with each of them containing 16 * 16 threads as defined in the compute shader
+        // we are adding 15 to ensure we round up when the dimensions are not multiples of 16
+        // coordinates (id's which we are using as pixel cordinates) are not in the bounds of the size of the screen then the shader will automatically discard them
+        // as written in the compute shader
+        // progressive frames only need one invocation per block
+        GLuint workGroupsX = ((width + traceScale - 1) / traceScale + 15) / 16;
+        GLuint workGroupsY = ((height + traceScale - 1) / traceScale + 15) / 16;
+        shader->dispatchCompute(workGroupsX, workGroupsY, 1);
+    }
 }
 
 void RayTracer::setTriangles(const std::vector<Triangle>& newTriangles) {
-    triangles = newTriangles;
+    scene.setTriangles(newTriangles);
     trianglesChanged = true;
-    buildBVH();
     bvhChanged = true;
 }
 
+bool RayTracer::loadOBJ(const std::string& filename, const Material& material) {
+    if (!scene.loadOBJ(filename, material)) {
+        return false;
+    }
+    trianglesChanged = true;
+    return true;
+}
+
 void RayTracer::setupTexture()
 {
     // this is just to create the texture with the size and bind to slot 0
@@ -219,18 +388,652 @@ void RayTracer::setupTexture()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    // only the tone mapping pass writes here, the accumulation itself lives in accumulationSSBO
     glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
 }
 
+void RayTracer::setupAccumulation()
+{
+    // no initial data needed, the trace pass starts every pixel over while frameCount is 0
+    GLsizeiptr size = GLsizeiptr(width) * height * sizeof(glm::dvec4);
+
+    glGenBuffers(1, &accumulationSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, accumulationSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, accumulationSSBO);
+
+    glGenBuffers(1, &historyAccumulationSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, historyAccumulationSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, historyAccumulationSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    tonemapShader = new Shader("shaders/tonemap.comp");
+}
+
+// level for this frame from the time since the last render call. the next finer level costs
+// about 4x, so it is only tried while frames take well under a quarter of the target
+int RayTracer::pickRenderScale(bool cameraMoved)
+{
+    auto now = std::chrono::steady_clock::now();
+    float frameMs = std::chrono::duration<float, std::milli>(now - lastRenderTime).count();
+    lastRenderTime = now;
+
+    if (!cameraMoved) {
+        // refine a level per frame once the camera rests
+        renderScale = glm::max(renderScale / 2, 1);
+        return renderScale;
+    }
+    if (frameMs > progressiveTargetMs && renderScale < 4) {
+        renderScale *= 2;
+    } else if (frameMs < progressiveTargetMs * 0.25f && renderScale > 1) {
+        renderScale /= 2;
+    }
+    return renderScale;
+}
+
+void RayTracer::setDebugView(DebugView view, float scale)
+{
+    if (view != debugView) {
+        frameCount = 0;
+    }
+    debugView = view;
+    if (scale > 0.0f) {
+        debugScale = scale;
+    } else {
+        // about where the default scene's expensive spots are
+        debugScale = view == DebugView::PathLength ? 8.0f : 64.0f;
+    }
+}
+
+// the denoiser needs every pixel, a coarse frame goes straight to the upscaling
+bool RayTracer::denoising() const
+{
+    return denoise && traceScale == 1 && debugView == DebugView::Off;
+}
+
+void RayTracer::updateDisplay()
+{
+    if (denoising()) {
+        profiler.begin("denoise");
+        runDenoiser();
+        profiler.end();
+    }
+    profiler.begin("tonemap");
+    runToneMap();
+    profiler.end();
+}
+
+void RayTracer::runToneMap()
+{
+    tonemapShader->use();
+    tonemapShader->setVec2("resolution", glm::vec2(width, height));
+    tonemapShader->setInt("useDenoised", denoising() ? 1 : 0);
+    tonemapShader->setInt("renderScale", traceScale);
+    tonemapShader->setFloat("exposure", exposure);
+    tonemapShader->setInt("toneMapper", static_cast<int>(toneMapper));
+    tonemapShader->setFloat("gamma", gamma);
+    tonemapShader->setInt("debugView", static_cast<int>(debugView));
+    tonemapShader->setFloat("debugScale", debugScale);
+
+    glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    if (denoising()) {
+        glBindImageTexture(4, denoiseTextures[(denoiseIterations - 1) % 2], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    }
+    tonemapShader->dispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+
+    // the display pass samples the result as a regular texture
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+std::vector<glm::dvec4> RayTracer::readAccumulation() const
+{
+    std::vector<glm::dvec4> accumulation(size_t(width) * height);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, accumulationSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, accumulation.size() * sizeof(glm::dvec4), accumulation.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // nothing traced yet (or just reset) reads as an empty image rather than stale sums
+    if (frameCount == 0) {
+        std::fill(accumulation.begin(), accumulation.end(), glm::dvec4(0.0));
+    }
+    return accumulation;
+}
+
+void RayTracer::restoreAccumulation(const glm::vec3& cameraPos,
+    const glm::vec3& cameraTarget,
+    const glm::vec3& cameraUp,
+    int frames,
+    const std::vector<glm::dvec4>& accumulation,
+    const std::vector<glm::vec4>& albedo,
+    const std::vector<glm::vec4>& normalDepth)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, accumulationSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size_t(width) * height * sizeof(glm::dvec4), accumulation.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, albedoTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, albedo.data());
+    glBindTexture(GL_TEXTURE_2D, normalDepthTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, normalDepth.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the trace pass reads both back with image loads
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // same camera as last frame, so render neither resets nor reprojects
+    prevCamPos = cameraPos;
+    prevCamTarget = cameraTarget;
+    prevCamUp = cameraUp;
+    frameCount = frames;
+}
+
 void RayTracer::setupShader()
 {
     computeShader = new Shader("shaders/raytracer.comp");
 }
 
+// screen sized texture for the compute passes, linear filtering so it can be displayed directly
+GLuint RayTracer::createImageTexture(GLenum internalFormat)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    return texture;
+}
+
+void RayTracer::setupAdaptiveSampling()
+{
+    // moments texture lives in image slot 1, the shader resets it whenever frameCount is 0
+    momentsTexture = createImageTexture(GL_RG32F);
+    glBindImageTexture(1, momentsTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+
+    // worst case every pixel is still active
+    glGenBuffers(1, &activePixelsSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, activePixelsSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, width * height * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, activePixelsSSBO);
+
+    // numGroupsX, numGroupsY, numGroupsZ, activeCount
+    GLuint dispatchArgs[4] = { 0, 1, 1, 0 };
+    glGenBuffers(1, &adaptiveDispatchSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, adaptiveDispatchSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(dispatchArgs), dispatchArgs, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, adaptiveDispatchSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    adaptiveShader = new Shader("shaders/adaptive.comp");
+}
+
+void RayTracer::compactActivePixels()
+{
+    GLuint dispatchArgs[4] = { 0, 1, 1, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, adaptiveDispatchSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(dispatchArgs), dispatchArgs);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    adaptiveShader->use();
+    adaptiveShader->setVec2("resolution", glm::vec2(width, height));
+    adaptiveShader->setInt("minSamples", adaptiveMinSamples);
+    adaptiveShader->setFloat("threshold", adaptiveThreshold);
+    adaptiveShader->dispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+
+    // the trace pass reads the list as an ssbo and the group count as an indirect command
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void RayTracer::setupDenoiser()
+{
+    // feature buffers written by the trace pass, slots 2 and 3
+    albedoTexture = createImageTexture(GL_RGBA16F);
+    normalDepthTexture = createImageTexture(GL_RGBA32F);
+    glBindImageTexture(2, albedoTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    glBindImageTexture(3, normalDepthTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+    // ping pong targets of the filter iterations
+    denoiseTextures[0] = createImageTexture(GL_RGBA32F);
+    denoiseTextures[1] = createImageTexture(GL_RGBA32F);
+
+    denoiseShader = new Shader("shaders/denoise.comp");
+}
+
+void RayTracer::runDenoiser()
+{
+    denoiseShader->use();
+    denoiseShader->setVec2("resolution", glm::vec2(width, height));
+    denoiseShader->setFloat("normalPhi", denoiseNormalPhi);
+    denoiseShader->setFloat("depthPhi", denoiseDepthPhi);
+
+    for (int i = 0; i < denoiseIterations; i++) {
+        // the first iteration reads the accumulation buffer, after that the previous iteration's result
+        // (on the first iteration the bound input is just a placeholder)
+        GLuint input = denoiseTextures[(i + 1) % 2];
+        glBindImageTexture(4, input, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(5, denoiseTextures[i % 2], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+        denoiseShader->setInt("stepWidth", 1 << i);
+        denoiseShader->setInt("firstPass", i == 0 ? 1 : 0);
+        denoiseShader->setInt("lastPass", i == denoiseIterations - 1 ? 1 : 0);
+        // coarser levels only smooth what is left, so they get stricter on color
+        denoiseShader->setFloat("colorPhi", denoiseColorPhi / float(1 << i));
+        denoiseShader->dispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+}
+
+void RayTracer::setupHistory()
+{
+    // same formats as moments, albedo and normal/depth, in that order
+    historyTextures[0] = createImageTexture(GL_RG32F);
+    historyTextures[1] = createImageTexture(GL_RGBA16F);
+    historyTextures[2] = createImageTexture(GL_RGBA32F);
+}
+
+void RayTracer::saveHistory()
+{
+    // the last trace pass wrote these through buffer and image stores
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, accumulationSSBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, historyAccumulationSSBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLsizeiptr(width) * height * sizeof(glm::dvec4));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    GLuint sources[3] = { momentsTexture, albedoTexture, normalDepthTexture };
+    for (int i = 0; i < 3; i++) {
+        glCopyImageSubData(sources[i], GL_TEXTURE_2D, 0, 0, 0, 0,
+            historyTextures[i], GL_TEXTURE_2D, 0, 0, 0, 0,
+            width, height, 1);
+    }
+}
+
+void RayTracer::setupWavefront()
+{
+    // at most one path per pixel is alive at a time
+    GLsizeiptr capacity = GLsizeiptr(width) * height;
+
+    // 144 bytes per PathState, see shaders/wavefront.glsl
+    glGenBuffers(1, &pathStatesSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pathStatesSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * 144, NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, pathStatesSSBO);
+
+    glGenBuffers(1, &rayQueuesSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayQueuesSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * capacity * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, rayQueuesSSBO);
+
+    glGenBuffers(1, &wavefrontCountersSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, wavefrontCountersSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * 4 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, wavefrontCountersSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    wavefrontGenerateShader = new Shader("shaders/wavefront_generate.comp");
+    wavefrontExtendShader = new Shader("shaders/wavefront_extend.comp");
+    wavefrontShadeShader = new Shader("shaders/wavefront_shade.comp");
+    wavefrontAccumulateShader = new Shader("shaders/wavefront_accumulate.comp");
+
+    Shader* passes[4] = { wavefrontGenerateShader, wavefrontExtendShader, wavefrontShadeShader, wavefrontAccumulateShader };
+    for (Shader* pass : passes) {
+        pass->use();
+        pass->setInt("queueCapacity", static_cast<int>(capacity));
+    }
+}
+
+GLuint RayTracer::readQueueCount(int queue) const
+{
+    GLuint count = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, wavefrontCountersSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, (queue * 4 + 3) * sizeof(GLuint), sizeof(GLuint), &count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
+
+// same image as the megakernel, but every pass runs over all live paths at once so
+// invocations of a group do the same work, extend and shade run once per bounce
+void RayTracer::traceWavefront(bool traceActiveList)
+{
+    // MAX_BOUNCES in scene.glsl
+    const int maxBounces = 1000;
+    // reading the queue size back stalls the pipeline, so it is only checked every few bounces.
+    // an empty queue just dispatches zero groups in between
+    const int emptyCheckInterval = 4;
+
+    // both ray queues and the path count start empty
+    GLuint emptyCounters[12] = { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, wavefrontCountersSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(emptyCounters), emptyCounters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    wavefrontGenerateShader->use();
+    dispatchPixels(wavefrontGenerateShader, traceActiveList);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, wavefrontCountersSSBO);
+    int inQueue = 0;
+    for (int bounce = 0; bounce < maxBounces; bounce++) {
+        int outQueue = 1 - inQueue;
+
+        wavefrontExtendShader->use();
+        wavefrontExtendShader->setInt("inQueue", inQueue);
+        wavefrontExtendShader->setInt("bounce", bounce);
+        wavefrontExtendShader->dispatchComputeIndirect(inQueue * 4 * sizeof(GLuint));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        wavefrontShadeShader->use();
+        wavefrontShadeShader->setInt("inQueue", inQueue);
+        wavefrontShadeShader->setInt("outQueue", outQueue);
+        wavefrontShadeShader->setInt("bounce", bounce);
+        wavefrontShadeShader->dispatchComputeIndirect(inQueue * 4 * sizeof(GLuint));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // the input queue has been consumed and becomes the output of the next bounce
+        glBufferSubData(GL_DISPATCH_INDIRECT_BUFFER, inQueue * 4 * sizeof(GLuint), 4 * sizeof(GLuint), emptyCounters);
+        inQueue = outQueue;
+
+        if ((bounce + 1) % emptyCheckInterval == 0 && readQueueCount(inQueue) == 0) {
+            break;
+        }
+    }
+
+    wavefrontAccumulateShader->use();
+    wavefrontAccumulateShader->dispatchComputeIndirect(2 * 4 * sizeof(GLuint));
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+void RayTracer::setupPersistent()
+{
+    glGenBuffers(1, &workPoolSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, workPoolSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 6 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, workPoolSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    persistentShader = new Shader("shaders/persistent.comp");
+
+    // the only driver known to stop long loops, see setPersistentIterationCap
+    const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    if (renderer && std::string(renderer).find("llvmpipe") != std::string::npos) {
+        persistentIterationCap = 1024;
+    }
+}
+
+// the group count does not depend on the image, the pool size (whole image or the
+// active list) is known to the shader. without an iteration cap one dispatch empties the pool
+// and nothing is read back
+void RayTracer::tracePersistent()
+{
+    // indirect group counts, nextWork, finishedWork, workTotal
+    GLuint pool[6] = { GLuint(persistentGroups), 1, 1, 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, workPoolSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(pool), pool);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    persistentShader->setInt("maxIterations", persistentIterationCap);
+    persistentShader->dispatchCompute(GLuint(persistentGroups), 1, 1);
+
+    if (persistentIterationCap > 0) {
+        // every invocation takes at least one batch (BATCH_SIZE in the shader) per dispatch
+        // while the pool lasts, so this many dispatches always empty it. the pool zeroes its
+        // group count once it ran dry and the rest cost next to nothing, the cpu never waits
+        GLuint perDispatch = GLuint(persistentGroups) * 64 * 4;
+        GLuint dispatches = (width * height + perDispatch - 1) / perDispatch;
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, workPoolSSBO);
+        for (GLuint i = 1; i < dispatches; i++) {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+            persistentShader->dispatchComputeIndirect(0);
+        }
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    }
+
+    // one read back to catch a driver that stops the kernel early, then never again
+    if (!persistentChecked) {
+        persistentChecked = true;
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, workPoolSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(pool), pool);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        if (pool[4] != pool[5]) {
+            std::cout << "Persistent kernel finished " << pool[4] << " of " << pool[5]
+                      << " pixels, set an iteration cap for this driver" << std::endl;
+        }
+    }
+}
+
+void RayTracer::setupMultiview()
+{
+    // both buffers get their storage once the view count is known
+    glGenBuffers(1, &viewCamerasSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, viewCamerasSSBO);
+    glGenBuffers(1, &viewAccumulationSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, viewAccumulationSSBO);
+
+    multiviewShader = new Shader("shaders/multiview.comp");
+}
+
+void RayTracer::resizeViews(size_t count)
+{
+    glDeleteTextures(1, &viewsTexture);
+    glGenTextures(1, &viewsTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, viewsTexture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, width, height, GLsizei(count), 0, GL_RGBA, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // position, target and up as vec4s, see ViewCamera in the shader
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, viewCamerasSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * 12 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    // no initial data needed, the shader starts every view over while viewFrameCount is 0
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, viewAccumulationSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * width * height * sizeof(glm::dvec4), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void RayTracer::renderViews(const std::vector<RenderCamera>& cameras)
+{
+    if (cameras.empty()) {
+        return;
+    }
+
+    bool camerasChanged = cameras.size() != viewCameras.size();
+    for (size_t i = 0; !camerasChanged && i < cameras.size(); i++) {
+        camerasChanged = cameras[i].position != viewCameras[i].position || cameras[i].target != viewCameras[i].target ||
+            cameras[i].up != viewCameras[i].up;
+    }
+
+    if (camerasChanged) {
+        if (cameras.size() != viewCameras.size()) {
+            resizeViews(cameras.size());
+        }
+        viewCameras = cameras;
+        viewFrameCount = 0;
+
+        std::vector<float> camerasData;
+        for (const auto& camera : cameras) {
+            for (const glm::vec3& v : { camera.position, camera.target, camera.up }) {
+                camerasData.push_back(v.x);
+                camerasData.push_back(v.y);
+                camerasData.push_back(v.z);
+                camerasData.push_back(0.0f);
+            }
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, viewCamerasSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, camerasData.size() * sizeof(float), camerasData.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    updateSSBO();
+    updateTrianglesSSBO();
+    updateBVHSSBO();
+    updateBVHIndicesSSBO();
+
+    multiviewShader->use();
+    setTraceUniforms(multiviewShader, cameras[0].position, cameras[0].target, cameras[0].up, false, false);
+    // the views keep their own sample count, the single camera accumulation is left alone
+    multiviewShader->setInt("frameCount", viewFrameCount);
+    multiviewShader->setInt("renderScale", 1);
+    multiviewShader->setInt("numViews", static_cast<int>(cameras.size()));
+    multiviewShader->setFloat("exposure", exposure);
+    multiviewShader->setInt("toneMapper", static_cast<int>(toneMapper));
+    multiviewShader->setFloat("gamma", gamma);
+
+    // layered so every view writes its own slice, runToneMap puts the output texture back
+    glBindImageTexture(0, viewsTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    multiviewShader->dispatchCompute((width + 15) / 16, (height + 15) / 16, GLuint(cameras.size()));
+    glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    viewFrameCount++;
+    if (rayCounting) {
+        copyRayCounters();
+    }
+}
+
+// (low, high) word pairs, see RayCounterTotals in shaders/scene.glsl
+static const int RAY_COUNTER_WORDS = 2 * (RAY_COUNTER_BOUNCES + 3);
+
+static RayCounters unpackRayCounters(const GLuint* words)
+{
+    auto value = [words](int counter) { return uint64_t(words[2 * counter]) | uint64_t(words[2 * counter + 1]) << 32; };
+    RayCounters counters;
+    for (int i = 0; i < RAY_COUNTER_BOUNCES; i++) {
+        counters.rays[i] = value(i);
+    }
+    counters.traversal.nodeVisits = value(RAY_COUNTER_BOUNCES);
+    counters.traversal.aabbTests = value(RAY_COUNTER_BOUNCES + 1);
+    counters.traversal.triangleTests = value(RAY_COUNTER_BOUNCES + 2);
+    return counters;
+}
+
+void RayTracer::setupRayCounters()
+{
+    GLuint zeros[RAY_COUNTER_WORDS] = {};
+    glGenBuffers(1, &rayCountersSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayCountersSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zeros), zeros, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, rayCountersSSBO);
+
+    for (RayCounterCopy& copy : rayCounterCopies) {
+        glGenBuffers(1, &copy.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, copy.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(zeros), NULL, GL_STREAM_READ);
+        copy.fence = 0;
+        copy.sequence = 0;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// snapshots the totals into the next copy buffer, skipped while that one is still on its way,
+// the totals keep running so the next snapshot has everything anyway
+void RayTracer::copyRayCounters()
+{
+    collectRayCounters();
+    RayCounterCopy& copy = rayCounterCopies[nextRayCounterCopy];
+    if (copy.fence) {
+        return;
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, rayCountersSSBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, copy.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, RAY_COUNTER_WORDS * sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    copy.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    copy.sequence = ++rayCounterSequence;
+    nextRayCounterCopy = (nextRayCounterCopy + 1) % RAY_COUNTER_COPIES;
+}
+
+// reads the copies that have landed without waiting for the others, the newest one wins
+void RayTracer::collectRayCounters()
+{
+    for (RayCounterCopy& copy : rayCounterCopies) {
+        if (!copy.fence || glClientWaitSync(copy.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            continue;
+        }
+        glDeleteSync(copy.fence);
+        copy.fence = 0;
+        if (copy.sequence < rayCounterTotalsSequence) {
+            continue;
+        }
+
+        GLuint words[RAY_COUNTER_WORDS];
+        glBindBuffer(GL_COPY_READ_BUFFER, copy.buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(words), words);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        rayCounterTotals = unpackRayCounters(words);
+        rayCounterTotalsSequence = copy.sequence;
+    }
+}
+
+RayCounters RayTracer::getRayCounters(bool wait)
+{
+    if (!wait) {
+        collectRayCounters();
+        return rayCounterTotals;
+    }
+
+    GLuint words[RAY_COUNTER_WORDS];
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayCountersSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(words), words);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    // copies still in flight are older than this
+    rayCounterTotals = unpackRayCounters(words);
+    rayCounterTotalsSequence = ++rayCounterSequence;
+    return rayCounterTotals;
+}
+
+void RayTracer::resetRayCounters()
+{
+    GLuint zeros[RAY_COUNTER_WORDS] = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayCountersSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeros), zeros);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    for (RayCounterCopy& copy : rayCounterCopies) {
+        if (copy.fence) {
+            glDeleteSync(copy.fence);
+            copy.fence = 0;
+        }
+    }
+    rayCounterTotals = RayCounters();
+    rayCounterTotalsSequence = ++rayCounterSequence;
+}
+
+std::vector<glm::dvec4> RayTracer::readViewAccumulation(int view) const
+{
+    std::vector<glm::dvec4> accumulation(size_t(width) * height, glm::dvec4(0.0));
+    if (view < 0 || view >= getViewCount() || viewFrameCount == 0) {
+        return accumulation;
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, viewAccumulationSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, GLintptr(view) * accumulation.size() * sizeof(glm::dvec4),
+        accumulation.size() * sizeof(glm::dvec4), accumulation.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return accumulation;
+}
+
 void RayTracer::setupSSBO()
 {
     spheresData.clear();
-    for (const auto& s : spheres) {
+    for (const auto& s : scene.getSpheres()) {
         spheresData.push_back(s.center.x);
         spheresData.push_back(s.center.y);
         spheresData.push_back(s.center.z);
@@ -252,7 +1055,7 @@ void RayTracer::updateSSBO()
 {
     if (spheresChanged) {
         spheresData.clear();
-        for (const auto& s : spheres) {
+        for (const auto& s : scene.getSpheres()) {
             spheresData.push_back(s.center.x);
             spheresData.push_back(s.center.y);
             spheresData.push_back(s.center.z);
@@ -272,7 +1075,7 @@ void RayTracer::updateSSBO()
 void RayTracer::setupTrianglesSSBO()
 {
     trianglesData.clear();
-    for (const auto& t : triangles) {
+    for (const auto& t : scene.getTriangles()) {
         // v0
         trianglesData.push_back(t.v0.x);
         trianglesData.push_back(t.v0.y);
@@ -308,7 +1111,7 @@ void RayTracer::updateTrianglesSSBO()
 {
     if (trianglesChanged) {
         trianglesData.clear();
-        for (const auto& t : triangles) {
+        for (const auto& t : scene.getTriangles()) {
             // v0
             trianglesData.push_back(t.v0.x);
             trianglesData.push_back(t.v0.y);
@@ -339,201 +1142,10 @@ void RayTracer::updateTrianglesSSBO()
     }
 }
 
-bool RayTracer::loadOBJ(const std::string& filename, const Material& material) {
-    tinyobj::attrib_t attrib{};
-    std::vector<tinyobj::shape_t> shapes{};
-    std::vector<tinyobj::material_t> materials{};
-    std::string warn, err;
-
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str());
-
-    if (!warn.empty()) {
-        std::cout << "Warning: " << warn << std::endl;
-    }
-
-    if (!err.empty()) {
-        std::cerr << "Error: " << err << std::endl;
-        return false;
-    }
-
-    if (!ret) {
-        std::cerr << "Failed to load OBJ file: " << filename << std::endl;
-        return false;
-    }
-
-    // Process each shape
-    for (const auto& shape : shapes) {
-        size_t index_offset = 0;
-        // Process each face
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
-            int fv = shape.mesh.num_face_vertices[f];
-            if (fv != 3) {
-                // Skip non-triangles for now
-                index_offset += fv;
-                continue;
-            }
-
-            // Get indices for the three vertices
-            tinyobj::index_t idx0 = shape.mesh.indices[index_offset + 0];
-            tinyobj::index_t idx1 = shape.mesh.indices[index_offset + 1];
-            tinyobj::index_t idx2 = shape.mesh.indices[index_offset + 2];
-
-            // Get vertex positions
-            glm::vec3 v0(attrib.vertices[3 * idx0.vertex_index + 0],
-                        attrib.vertices[3 * idx0.vertex_index + 1],
-                        attrib.vertices[3 * idx0.vertex_index + 2]);
-            glm::vec3 v1(attrib.vertices[3 * idx1.vertex_index + 0],
-                        attrib.vertices[3 * idx1.vertex_index + 1],
-                        attrib.vertices[3 * idx1.vertex_index + 2]);
-            glm::vec3 v2(attrib.vertices[3 * idx2.vertex_index + 0],
-                        attrib.vertices[3 * idx2.vertex_index + 1],
-                        attrib.vertices[3 * idx2.vertex_index + 2]);
-
-            // // Scale the model
-            // float scale = 1.0f;
-            // if (filename == "bunny.obj") {
-            //     scale = 5.0f;
-            // } else if (filename == "cube.OBJ") {
-            //     scale = 2.0f;
-            // }
-            // v0 *= scale;
-            // v1 *= scale;
-            // v2 *= scale;
-
-
-            // Get or compute normal
-            glm::vec3 normal(0.0f);
-            if (idx0.normal_index >= 0 && idx1.normal_index >= 0 && idx2.normal_index >= 0) {
-                // Use provided normals
-                glm::vec3 n0(attrib.normals[3 * idx0.normal_index + 0],
-                            attrib.normals[3 * idx0.normal_index + 1],
-                            attrib.normals[3 * idx0.normal_index + 2]);
-                glm::vec3 n1(attrib.normals[3 * idx1.normal_index + 0],
-                            attrib.normals[3 * idx1.normal_index + 1],
-                            attrib.normals[3 * idx1.normal_index + 2]);
-                glm::vec3 n2(attrib.normals[3 * idx2.normal_index + 0],
-                            attrib.normals[3 * idx2.normal_index + 1],
-                            attrib.normals[3 * idx2.normal_index + 2]);
-                // Average the normals
-                normal = glm::normalize((n0 + n1 + n2) / 3.0f);
-            } else {
-                // Compute normal from vertices
-                glm::vec3 edge1 = v1 - v0;
-                glm::vec3 edge2 = v2 - v0;
-                normal = glm::normalize(glm::cross(edge1, edge2));
-            }
-
-            // Create triangle
-            Triangle tri;
-            tri.v0 = v0;
-            tri.v1 = v1;
-            tri.v2 = v2;
-            tri.normal = normal;
-            tri.material = material;
-
-            // Add to triangles vector
-            triangles.push_back(tri);
-
-            index_offset += fv;
-        }
-    }
-
-    trianglesChanged = true;
-    // buildBVH();
-    // bvhChanged = true;
-    std::cout << "Loaded " << triangles.size() << " triangles from " << filename << std::endl;
-    
-    return true;
-}
-
-AABB RayTracer::computeTriangleAABB(const Triangle& tri) {
-    AABB aabb;
-    aabb.expand(tri.v0);
-    aabb.expand(tri.v1);
-    aabb.expand(tri.v2);
-    return aabb;
-}
-
-glm::vec3 RayTracer::computeTriangleCentroid(const Triangle& tri) {
-    return (tri.v0 + tri.v1 + tri.v2) / 3.0f;
-}
-
-void RayTracer::buildBVH() {
-    if (triangles.empty()) {
-        bvhNodes.clear();
-        triangleIndices.clear();
-        bvhChanged = true;
-        return;
-    }
-
-    std::cout << "Building BVH for " << triangles.size() << " triangles..." << std::endl;
-    auto start_time = std::chrono::high_resolution_clock::now();
-
-    triangleIndices.resize(triangles.size());
-    std::iota(triangleIndices.begin(), triangleIndices.end(), 0);
-
-    std::vector<glm::vec3> centroids(triangles.size());
-    for (size_t i = 0; i < triangles.size(); i++) {
-        centroids[i] = computeTriangleCentroid(triangles[i]);
-    }
-
-    
-    bvhNodes.clear();
-    bvhNodes.reserve(2 * triangles.size());
-
-    buildBVHRecursive(0, static_cast<int>(triangles.size()), triangleIndices, centroids);
-    
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-    
-    bvhChanged = true;
-    std::cout << bvhNodes.size() << " nodes in " << duration.count() << "ms" << std::endl;
-}
-
-int RayTracer::buildBVHRecursive(int start, int end, std::vector<int>& indices, const std::vector<glm::vec3>& centroids) {
-    int nodeIndex = static_cast<int>(bvhNodes.size());
-    bvhNodes.emplace_back();
-    BVHNode& node = bvhNodes[nodeIndex];
-
-    for (int i = start; i < end; i++) {
-        const Triangle& tri = triangles[indices[i]];
-        AABB triAABB = computeTriangleAABB(tri);
-        node.bounds.expand(triAABB);
-    }
-
-    int triCount = end - start;
-    
-    if (triCount <= 8) {
-        node.firstTriIndex = start;
-        node.triCount = triCount;
-        return nodeIndex;
-    }
-
-    // Find the longest axis and split at median
-    // Suggestion: we can make a surface based spilit function which is way more optimized
-    glm::vec3 extent = node.bounds.max - node.bounds.min;
-    int splitAxis = 0;
-    if (extent.y > extent.x) splitAxis = 1;
-    if (extent.z > extent[splitAxis]) splitAxis = 2;
-
-    // Sort triangles by centroid along the split axis
-    std::sort(indices.begin() + start, indices.begin() + end, 
-              [&centroids, splitAxis](int a, int b) {
-                  return centroids[a][splitAxis] < centroids[b][splitAxis];
-              });
-
-    int split = start + triCount / 2;
-
-    node.leftChild = buildBVHRecursive(start, split, indices, centroids);
-    node.rightChild = buildBVHRecursive(split, end, indices, centroids);
-
-    return nodeIndex;
-}
-
 void RayTracer::setupBVHSSBO() {
     bvhData.clear();
     
-    for (const auto& node : bvhNodes) {
+    for (const auto& node : scene.getBVHNodes()) {
         // AABB min
         bvhData.push_back(node.bounds.min.x);
         bvhData.push_back(node.bounds.min.y);
@@ -567,7 +1179,7 @@ void RayTracer::updateBVHSSBO() {
         bvhData.clear();
         
         // Serialize BVH nodes
-        for (const auto& node : bvhNodes) {
+        for (const auto& node : scene.getBVHNodes()) {
             // AABB min
             bvhData.push_back(node.bounds.min.x);
             bvhData.push_back(node.bounds.min.y);
@@ -597,7 +1209,7 @@ void RayTracer::updateBVHSSBO() {
 void RayTracer::setupBVHIndicesSSBO() {
     bvhIndicesData.clear();
     
-    for (int index : triangleIndices) {
+    for (int index : scene.getTriangleIndices()) {
         bvhIndicesData.push_back(static_cast<float>(index));
     }
 
@@ -612,7 +1224,7 @@ void RayTracer::updateBVHIndicesSSBO() {
     if (bvhChanged) {
         bvhIndicesData.clear();
         
-        for (int index : triangleIndices) {
+        for (int index : scene.getTriangleIndices()) {
             bvhIndicesData.push_back(static_cast<float>(index));
         }
 
@@ -1,122 +1,344 @@
 #ifndef RAY_TRACER_H
 #define RAY_TRACER_H
 
+#include "GpuProfiler.h"
+#include "RayCounters.h"
 #include "Shader.h"
+#include "Sampler.h"
+#include "Scene.h"
+#include "ToneMap.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <chrono>
 #include <vector>
 
-struct Material {
-    glm::vec3 color;
-    int type; // 0 = Lambertian, 1 = Light
+// How a frame's paths are mapped onto the gpu, all of them produce the same image
+enum class TraceKernel {
+    // raytracer.comp, one invocation per pixel for the whole path
+    Megakernel,
+    // generate, extend, shade and accumulate passes talking through ray queues, see shaders/wavefront.glsl
+    Wavefront,
+    // persistent.comp, a fixed number of groups pulling pixels from a global pool
+    Persistent
 };
 
-struct Sphere {
-    glm::vec3 center;
-    float radius;
-    Material material;
+// What the image shows, the debug views color every pixel by what tracing it cost
+enum class DebugView {
+    Off = 0,
+    // bvh nodes the camera ray went into
+    NodeVisits = 1,
+    // triangles the camera ray was tested against
+    TriangleTests = 2,
+    // rays in the pixel's path, the camera ray included
+    PathLength = 3
 };
 
-struct Triangle {
-    glm::vec3 v0, v1, v2;
-    glm::vec3 normal;
-    Material material;
-};
-
-struct AABB {
-    glm::vec3 min;
-    glm::vec3 max;
-    
-    AABB() : min(1e30f), max(-1e30f) {}
-    AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
-    
-    void expand(const glm::vec3& point) {
-        min = glm::min(min, point);
-        max = glm::max(max, point);
-    }
-    
-    void expand(const AABB& box) {
-        min = glm::min(min, box.min);
-        max = glm::max(max, box.max);
-    }
-    
-    glm::vec3 center() const {
-        return (min + max) * 0.5f;
-    }
-    
-    float surfaceArea() const {
-        glm::vec3 extent = max - min;
-        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
-    }
-};
-
-struct BVHNode {
-    AABB bounds;
-    int leftChild;   // Index to left child node -1 if leaf
-    int rightChild;  // Index to right child node -1 if leaf
-    int firstTriIndex; // Index of first triangle in leaf nodes
-    int triCount;    // Number of triangles in leaf nodes
-
-    BVHNode() : leftChild(-1), rightChild(-1), firstTriIndex(0), triCount(0) {}
-    
-    bool isLeaf() const {
-        return leftChild == -1 && rightChild == -1;
-    }
+struct RenderCamera {
+    glm::vec3 position;
+    glm::vec3 target;
+    glm::vec3 up;
 };
 
 class RayTracer {
 public:
+    // the default scene
     RayTracer(GLuint width, GLuint height);
+    // renders the given scene, its BVH is built here if it has none yet
+    RayTracer(GLuint width, GLuint height, Scene scene);
     ~RayTracer();
 
     void render(const glm::vec3& cameraPos,
         const glm::vec3& cameraTarget,
         const glm::vec3& cameraUp);
     
-    // Get the texture containing the rendered image
+    // Get the texture containing the rendered image (tone mapped, denoised when the denoiser is on)
     GLuint getOutputTexture() const { return outputTexture; }
 
+    // Throws the accumulated samples away, the next render starts over
+    void resetAccumulation() { frameCount = 0; }
+    int getFrameCount() const { return frameCount; }
+    // Puts back state saved from readAccumulation and the feature textures, the next render from
+    // the same camera carries on as if there had been no break. The adaptive sampling moments
+    // are not part of it, keep adaptive sampling off for restored renders
+    void restoreAccumulation(const glm::vec3& cameraPos,
+        const glm::vec3& cameraTarget,
+        const glm::vec3& cameraUp,
+        int frames,
+        const std::vector<glm::dvec4>& accumulation,
+        const std::vector<glm::vec4>& albedo,
+        const std::vector<glm::vec4>& normalDepth);
+
+    // Traces one more sample for every camera in a single dispatch, the z dimension picks the view.
+    // Each view accumulates on its own and is tone mapped into its layer of getViewsTexture(),
+    // paths and seeds are the ones render() uses with adaptive sampling and reprojection off.
+    // Different cameras (or a different count) start all views over, views are never denoised
+    void renderViews(const std::vector<RenderCamera>& cameras);
+    // GL_TEXTURE_2D_ARRAY with one layer per camera of the last renderViews call
+    GLuint getViewsTexture() const { return viewsTexture; }
+    int getViewCount() const { return static_cast<int>(viewCameras.size()); }
+    // Like readAccumulation for one of the views
+    std::vector<glm::dvec4> readViewAccumulation(int view) const;
+
+    // Reruns the denoise and tone mapping passes without tracing, for example after changing the exposure
+    void updateDisplay();
+
+    // Per pixel radiance sums (xyz) and sample counts (w), row major like the output texture.
+    // Reading never disturbs the accumulation so the image can be exported at any time
+    std::vector<glm::dvec4> readAccumulation() const;
+    GLuint getAccumulationBuffer() const { return accumulationSSBO; }
+
+    // First hit feature buffers that guide the denoiser
+    GLuint getAlbedoTexture() const { return albedoTexture; }
+    GLuint getNormalDepthTexture() const { return normalDepthTexture; }
+
     // Update spheres data (only when changed)
     void setSpheres(const std::vector<Sphere>& newSpheres) {
-        spheres = newSpheres;
+        scene.setSpheres(newSpheres);
         spheresChanged = true;
     }
 
     // Get current spheres
-    const std::vector<Sphere>& getSpheres() const { return spheres; }
+    const std::vector<Sphere>& getSpheres() const { return scene.getSpheres(); }
 
     void setTriangles(const std::vector<Triangle>& newTriangles);
 
-    const std::vector<Triangle>& getTriangles() const { return triangles; }
+    const std::vector<Triangle>& getTriangles() const { return scene.getTriangles(); }
+
+    const Scene& getScene() const { return scene; }
 
     bool loadOBJ(const std::string& filename, const Material& material = {{0.8f, 0.8f, 0.8f}, 0});
 
+    // Adaptive sampling, once a pixel has adaptiveMinSamples samples it is only traced
+    // again while the standard error of its luminance is above threshold * mean
+    void setAdaptiveSampling(bool enabled) { adaptiveSampling = enabled; }
+    bool getAdaptiveSampling() const { return adaptiveSampling; }
+    void setAdaptiveThreshold(float threshold) { adaptiveThreshold = threshold; }
+    void setAdaptiveMinSamples(int samples) { adaptiveMinSamples = samples; }
+
+    // Which sequence the shader draws its random numbers from, restarts accumulation
+    void setSamplerType(SamplerType type) {
+        samplerType = type;
+        frameCount = 0;
+    }
+    SamplerType getSamplerType() const { return samplerType; }
+
+    // Edge aware a-trous denoiser run on the accumulated image every frame,
+    // iterations is clamped to 1..10 (step widths 1, 2, 4, ...)
+    void setDenoise(bool enabled) { denoise = enabled; }
+    bool getDenoise() const { return denoise; }
+    void setDenoiseIterations(int iterations) { denoiseIterations = glm::clamp(iterations, 1, 10); }
+    void setDenoiseSigmas(float colorPhi, float normalPhi, float depthPhi) {
+        denoiseColorPhi = colorPhi;
+        denoiseNormalPhi = normalPhi;
+        denoiseDepthPhi = depthPhi;
+    }
+
+    // Temporal reprojection, a camera move carries the accumulation over to the new view
+    // instead of resetting it. Pixels whose surface was not visible before start over,
+    // the rest keep at most maxHistory samples of history
+    void setTemporalReprojection(bool enabled) { temporalReprojection = enabled; }
+    bool getTemporalReprojection() const { return temporalReprojection; }
+    void setMaxHistory(int samples) { maxHistory = samples; }
+    void setReprojectDepthTolerance(float tolerance) { reprojectDepthTolerance = tolerance; }
+
+    // Which kernel layout traces the paths, only changes throughput
+    void setTraceKernel(TraceKernel kernel) { traceKernel = kernel; }
+    TraceKernel getTraceKernel() const { return traceKernel; }
+    // Groups of 64 invocations launched by the persistent kernel, should be about
+    // what the gpu keeps resident at once
+    void setPersistentGroups(int groups) { persistentGroups = glm::max(groups, 1); }
+    // Loop iterations (bounces plus traversal steps) after which an invocation of the persistent
+    // kernel stops taking pixels in a dispatch, further indirect dispatches then finish the pool.
+    // 0, the default, keeps every invocation going until the pool is empty in one dispatch.
+    // llvmpipe gives up on a loop after 65535 iterations, so it gets 1024 there
+    void setPersistentIterationCap(int iterations) { persistentIterationCap = glm::max(iterations, 0); }
+
+    // Debug views of the megakernel's own traversal, the cost is accumulated like radiance and
+    // shown from blue (nothing) to red (scale or more, 0 keeps the view's default). While a view
+    // is on the megakernel traces whatever kernel is set and adaptive sampling, reprojection and
+    // the denoiser stay out of the way. switching starts the accumulation over
+    void setDebugView(DebugView view, float scale = 0.0f);
+    DebugView getDebugView() const { return debugView; }
+    float getDebugScale() const { return debugScale; }
+
+    // Progressive resolution for interactive use. While the camera moves only the middle pixel
+    // of every 2x2 or 4x4 block is traced (1/4 or 1/16 of the work) and the tone mapping pass
+    // upscales it, the block size follows the time between render calls to stay near the
+    // target. Once the camera stops every frame goes a level finer until the full resolution
+    // accumulates as usual
+    void setProgressive(bool enabled) { progressive = enabled; }
+    bool getProgressive() const { return progressive; }
+    void setProgressiveTarget(float frameMs) { progressiveTargetMs = frameMs; }
+    // 1, 2 or 4, the block size of the last traced frame
+    int getRenderScale() const { return traceScale; }
+
+    // Frame time budget in ms for the megakernel, 0 traces a whole frame per render call. Otherwise
+    // a frame is split into tiles and a render call only issues as many as fit into the budget by
+    // the gpu timer queries of the earlier calls, the next call carries on where it stopped.
+    // The display is updated after every call, frame counts only go up once a frame is complete
+    void setFrameBudget(float budgetMs) { frameBudgetMs = budgetMs; }
+    float getFrameBudget() const { return frameBudgetMs; }
+
+    // Display settings, exposure is in stops
+    void setExposure(float stops) { exposure = stops; }
+    void setToneMapper(ToneMapper mapper) { toneMapper = mapper; }
+    void setGamma(float newGamma) { gamma = newGamma; }
+
+    // Gpu time per stage of render (upload, history, adaptive, trace, denoise, tonemap), off until
+    // enabled. every render call is a profiler frame, callers can add their own stages after it
+    GpuProfiler& getProfiler() { return profiler; }
+
+    // Counts the rays every trace kernel casts and the bvh work they cost into 64 bit running
+    // totals on the gpu (RayCounters.h), a few atomics per ray while on. the totals are copied
+    // out after every render call and only read once a copy has landed, so getRayCounters lags
+    // a frame or two unless wait is set, which reads the buffer directly and stalls
+    void setRayCounters(bool enabled) { rayCounting = enabled; }
+    bool getRayCountersEnabled() const { return rayCounting; }
+    RayCounters getRayCounters(bool wait = false);
+    void resetRayCounters();
+
 private:
+    Scene scene;
+
     GLuint width;
     GLuint height;
     GLuint outputTexture;
     Shader* computeShader;
 
+    // Radiance sums and sample counts as doubles, written only by the trace pass
+    GLuint accumulationSSBO;
+    Shader* tonemapShader;
+    float exposure;
+    ToneMapper toneMapper;
+    float gamma;
+
+    // Adaptive sampling state, see shaders/adaptive.comp
+    GLuint momentsTexture;
+    Shader* adaptiveShader;
+    GLuint activePixelsSSBO;
+    GLuint adaptiveDispatchSSBO;
+    bool adaptiveSampling;
+    float adaptiveThreshold;
+    int adaptiveMinSamples;
+
+    // Denoiser state, see shaders/denoise.comp
+    GLuint albedoTexture;
+    GLuint normalDepthTexture;
+    GLuint denoiseTextures[2];
+    Shader* denoiseShader;
+    bool denoise;
+    int denoiseIterations;
+    float denoiseColorPhi;
+    float denoiseNormalPhi;
+    float denoiseDepthPhi;
+
+    // Reprojection state, the history holds copies of the accumulation, moments,
+    // albedo and normal/depth from before the move
+    GLuint historyAccumulationSSBO;
+    GLuint historyTextures[3];
+    bool temporalReprojection;
+    int maxHistory;
+    float reprojectDepthTolerance;
+
+    // Wavefront state, path states, the two ray queues and their counters
+    Shader* wavefrontGenerateShader;
+    Shader* wavefrontExtendShader;
+    Shader* wavefrontShadeShader;
+    Shader* wavefrontAccumulateShader;
+    GLuint pathStatesSSBO;
+    GLuint rayQueuesSSBO;
+    GLuint wavefrontCountersSSBO;
+    TraceKernel traceKernel;
+
+    // Persistent threads state, the pool is reset before the first dispatch of every frame.
+    // the first frame reads it back once to check that every pixel was traced
+    Shader* persistentShader;
+    GLuint workPoolSSBO;
+    int persistentGroups;
+    int persistentIterationCap;
+    bool persistentChecked;
+
+    // Multi view state, see shaders/multiview.comp. the array texture and the accumulation
+    // are sized for viewCameras.size() views and reallocated when the count changes
+    Shader* multiviewShader;
+    GLuint viewsTexture;
+    GLuint viewCamerasSSBO;
+    GLuint viewAccumulationSSBO;
+    std::vector<RenderCamera> viewCameras;
+    int viewFrameCount;
+
+    DebugView debugView;
+    float debugScale;
+
+    // Progressive state, renderScale is the level picked for moving frames and traceScale
+    // the one the last frame was traced at
+    bool progressive;
+    float progressiveTargetMs;
+    int renderScale;
+    int traceScale;
+    std::chrono::steady_clock::time_point lastRenderTime;
+
+    GpuProfiler profiler;
+
+    // Ray counter state, the totals buffer (binding 15) and the copies on their way back
+    static const int RAY_COUNTER_COPIES = 3;
+    struct RayCounterCopy {
+        GLuint buffer;
+        GLsync fence;
+        long long sequence;
+    };
+    bool rayCounting;
+    GLuint rayCountersSSBO;
+    RayCounterCopy rayCounterCopies[RAY_COUNTER_COPIES];
+    int nextRayCounterCopy;
+    long long rayCounterSequence;
+    long long rayCounterTotalsSequence;
+    RayCounters rayCounterTotals;
+
+    // Per frame decisions, kept for the calls that continue a budgeted frame
+    bool frameReprojecting;
+    bool frameActiveList;
+    glm::vec3 frameCamPos;
+    glm::vec3 frameCamTarget;
+    glm::vec3 frameCamUp;
+
+    // Budgeted frame state, a tile is BUDGET_TILE_SIDE^2 groups: a square of blocks or a run of
+    // the active list. a pair of timestamp queries goes around the tiles of every call (some
+    // drivers, llvmpipe among them, report 0 for GL_TIME_ELAPSED around compute), the few last
+    // pairs stay in flight so reading them never stalls
+    static const int BUDGET_TILE_SIDE = 8;
+    static const int BUDGET_TILE_PIXELS = BUDGET_TILE_SIDE * BUDGET_TILE_SIDE * 256;
+    static const int BUDGET_TIMINGS = 4;
+    struct BudgetTiming {
+        GLuint queries[2];
+        bool pending;
+        long long pixels;
+    };
+    float frameBudgetMs;
+    int nextTile;
+    int tileCount;
+    int budgetListLength;
+    double budgetMsPerPixel;
+    BudgetTiming budgetTimings[BUDGET_TIMINGS];
+    int nextBudgetTiming;
+
     // Frame count for accumulation
     int frameCount;
+    SamplerType samplerType;
 
     // Previous camera parameters to detect movement
     glm::vec3 prevCamPos;
     glm::vec3 prevCamTarget;
     glm::vec3 prevCamUp;
 
-    std::vector<Sphere> spheres;
     std::vector<float> spheresData;
     GLuint ssbo;
     bool spheresChanged;
 
-    std::vector<Triangle> triangles;
     std::vector<float> trianglesData;
     GLuint trianglesSSBO;
     bool trianglesChanged;
 
-    std::vector<BVHNode> bvhNodes;
-    std::vector<int> triangleIndices;
     std::vector<float> bvhData;
     std::vector<float> bvhIndicesData;
     GLuint bvhSSBO;
@@ -124,16 +346,41 @@ private:
     bool bvhChanged;
 
     void setupTexture();
+    void setupAccumulation();
+    void runToneMap();
+    bool denoising() const;
+    GLuint createImageTexture(GLenum internalFormat);
     void setupShader();
     void setupSSBO();
     void updateSSBO();
     void setupTrianglesSSBO();
     void updateTrianglesSSBO();
-    
-    AABB computeTriangleAABB(const Triangle& tri);
-    glm::vec3 computeTriangleCentroid(const Triangle& tri);
-    void buildBVH();
-    int buildBVHRecursive(int start, int end, std::vector<int>& indices, const std::vector<glm::vec3>& centroids);
+    void setupAdaptiveSampling();
+    void compactActivePixels();
+    void setupDenoiser();
+    void runDenoiser();
+    void setupHistory();
+    void saveHistory();
+    void setTraceUniforms(const Shader* shader, const glm::vec3& cameraPos, const glm::vec3& cameraTarget,
+        const glm::vec3& cameraUp, bool traceActiveList, bool reprojecting) const;
+    void dispatchPixels(const Shader* shader, bool traceActiveList) const;
+    void setupWavefront();
+    void traceWavefront(bool traceActiveList);
+    GLuint readQueueCount(int queue) const;
+    void setupPersistent();
+    void tracePersistent();
+    int pickRenderScale(bool cameraMoved);
+    void beginFrame(const glm::vec3& cameraPos, const glm::vec3& cameraTarget, const glm::vec3& cameraUp, bool budgeted);
+    int budgetTilesX() const;
+    int budgetTilesY() const;
+    bool traceBudgeted();
+    void collectBudgetTimings();
+    void setupMultiview();
+    void resizeViews(size_t count);
+    void setupRayCounters();
+    void copyRayCounters();
+    void collectRayCounters();
+
     void setupBVHSSBO();
     void updateBVHSSBO();
     void setupBVHIndicesSSBO();
@@ -0,0 +1,276 @@
+#include "Regression.h"
+#include "Benchmark.h"
+#include "ImageIO.h"
+#include "OfflineRenderer.h"
+#include "ToneMap.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+// errors above this count as a visibly wrong pixel
+#define REGRESSION_ERROR_PIXEL 0.1f
+
+RegressionSuite defaultRegressionSuite()
+{
+    RegressionSuite suite;
+    RenderCamera window = { glm::vec3(0.0f, 1.5f, 2.0f), glm::vec3(0.0f, 1.5f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    RenderCamera side = { glm::vec3(2.5f, 2.0f, 1.0f), glm::vec3(0.0f, 0.5f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    suite.cases = {
+        { "default", "default", false, window },
+        { "default-side", "default", false, side },
+        { "bunny", "bunny.obj", true, RenderCamera() },
+        { "bunny2", "bunny2.obj", true, RenderCamera() },
+        { "synthetic", "synthetic:20000", true, RenderCamera() },
+    };
+    return suite;
+}
+
+static glm::vec3 toLab(const glm::vec3& rgb)
+{
+    // linear srgb to xyz, white point d65
+    glm::vec3 xyz(
+        0.4124f * rgb.r + 0.3576f * rgb.g + 0.1805f * rgb.b,
+        0.2126f * rgb.r + 0.7152f * rgb.g + 0.0722f * rgb.b,
+        0.0193f * rgb.r + 0.1192f * rgb.g + 0.9505f * rgb.b);
+    xyz /= glm::vec3(0.9505f, 1.0f, 1.0888f);
+    for (int i = 0; i < 3; i++) {
+        xyz[i] = xyz[i] > 0.008856f ? std::cbrt(xyz[i]) : 7.787f * xyz[i] + 16.0f / 116.0f;
+    }
+    return glm::vec3(116.0f * xyz.y - 16.0f, 500.0f * (xyz.x - xyz.y), 200.0f * (xyz.y - xyz.z));
+}
+
+static float hyab(const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec3 d = a - b;
+    return std::abs(d.x) + std::sqrt(d.y * d.y + d.z * d.z);
+}
+
+// 3x3 binomial in display space, edges clamp
+static std::vector<glm::vec3> blurred(const std::vector<glm::vec3>& image, int width, int height)
+{
+    const float weights[3] = { 0.25f, 0.5f, 0.25f };
+    std::vector<glm::vec3> result(image.size());
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            glm::vec3 sum(0.0f);
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int sx = glm::clamp(x + dx, 0, width - 1);
+                    int sy = glm::clamp(y + dy, 0, height - 1);
+                    sum += weights[dx + 1] * weights[dy + 1] * image[size_t(sy) * width + sx];
+                }
+            }
+            result[size_t(y) * width + x] = sum;
+        }
+    }
+    return result;
+}
+
+ImageComparison compareImages(const std::vector<glm::vec4>& reference, const std::vector<glm::vec4>& image, int width, int height)
+{
+    size_t pixels = size_t(width) * height;
+    std::vector<glm::vec3> referenceDisplay(pixels);
+    std::vector<glm::vec3> imageDisplay(pixels);
+    double squaredError = 0.0;
+    for (size_t i = 0; i < pixels; i++) {
+        referenceDisplay[i] = toneMap(glm::vec3(reference[i]), 0.0f, ToneMapper::None, 1.0f);
+        imageDisplay[i] = toneMap(glm::vec3(image[i]), 0.0f, ToneMapper::None, 1.0f);
+        glm::vec3 d = referenceDisplay[i] - imageDisplay[i];
+        squaredError += double(glm::dot(d, d));
+    }
+    referenceDisplay = blurred(referenceDisplay, width, height);
+    imageDisplay = blurred(imageDisplay, width, height);
+
+    // FLIP's normalisation, the distance between pure green and pure blue, with its 0.7 power
+    // that lifts small differences the eye still notices
+    float maxDistance = std::pow(hyab(toLab(glm::vec3(0.0f, 1.0f, 0.0f)), toLab(glm::vec3(0.0f, 0.0f, 1.0f))), 0.7f);
+
+    ImageComparison comparison;
+    comparison.rmse = pixels > 0 ? std::sqrt(squaredError / double(pixels * 3)) : 0.0;
+    comparison.meanError = 0.0;
+    comparison.maxError = 0.0;
+    comparison.errorPixels = 0.0;
+    comparison.errorMap.resize(pixels);
+    for (size_t i = 0; i < pixels; i++) {
+        float error = std::min(std::pow(hyab(toLab(referenceDisplay[i]), toLab(imageDisplay[i])), 0.7f) / maxDistance, 1.0f);
+        comparison.errorMap[i] = error;
+        comparison.meanError += error;
+        comparison.maxError = std::max(comparison.maxError, double(error));
+        comparison.errorPixels += error > REGRESSION_ERROR_PIXEL;
+    }
+    if (pixels > 0) {
+        comparison.meanError /= double(pixels);
+        comparison.errorPixels /= double(pixels);
+    }
+    return comparison;
+}
+
+static bool withinTolerance(const ImageComparison& comparison, const RegressionTolerance& tolerance)
+{
+    return comparison.rmse <= tolerance.rmse && comparison.meanError <= tolerance.meanError
+        && comparison.errorPixels <= tolerance.errorPixels;
+}
+
+static void logComparison(std::ostream& log, const std::string& name, bool passed, const ImageComparison& comparison)
+{
+    std::ios::fmtflags flags = log.flags();
+    std::streamsize precision = log.precision();
+    log << std::left << std::setw(24) << name << std::right << (passed ? "pass" : "FAIL")
+        << std::fixed << std::setprecision(5) << "  rmse " << comparison.rmse << "  mean error " << comparison.meanError
+        << "  max error " << comparison.maxError << std::setprecision(3) << "  error pixels "
+        << comparison.errorPixels * 100.0 << "%" << std::endl;
+    log.flags(flags);
+    log.precision(precision);
+}
+
+// renders the cameras of all cases with the same scene in one RayTracer::renderViews call per
+// sample and compares every view with the image render() made of it in this run. they trace
+// the same paths, so this catches multiview.comp drifting away from the single camera kernels
+static int checkViews(const RegressionSuite& suite, const std::function<void(RayTracer&)>& configureGpu,
+    const std::vector<RenderCamera>& cameras, const std::vector<std::vector<glm::vec4>>& images, std::ostream& log)
+{
+    int failed = 0;
+    std::vector<bool> checked(suite.cases.size(), false);
+    for (size_t first = 0; first < suite.cases.size(); first++) {
+        if (checked[first]) {
+            continue;
+        }
+        std::vector<size_t> group;
+        for (size_t i = first; i < suite.cases.size(); i++) {
+            if (suite.cases[i].scene == suite.cases[first].scene && !images[i].empty()) {
+                group.push_back(i);
+                checked[i] = true;
+            }
+        }
+        if (group.empty()) {
+            continue;
+        }
+
+        Scene scene;
+        double loadMs = 0.0;
+        double buildMs = 0.0;
+        if (!loadBenchmarkScene(suite.cases[first].scene, scene, loadMs, buildMs)) {
+            log << suite.cases[first].name << " (views): could not load " << suite.cases[first].scene << std::endl;
+            failed += int(group.size());
+            continue;
+        }
+        OfflineRenderer renderer(suite.width, suite.height, std::move(scene), false);
+        if (!renderer.onGpu()) {
+            log << suite.cases[first].name << " (views): no gpu context for the views" << std::endl;
+            failed += int(group.size());
+            continue;
+        }
+        RayTracer& rayTracer = *renderer.getRayTracer();
+        configureGpu(rayTracer);
+
+        std::vector<RenderCamera> views;
+        for (size_t i : group) {
+            views.push_back(cameras[i]);
+        }
+        for (int sample = 0; sample < suite.samples; sample++) {
+            rayTracer.renderViews(views);
+        }
+
+        for (size_t view = 0; view < group.size(); view++) {
+            const RegressionCase& regressionCase = suite.cases[group[view]];
+            std::vector<glm::vec4> image = averageAccumulation(rayTracer.readViewAccumulation(int(view)));
+            ImageComparison comparison = compareImages(images[group[view]], image, suite.width, suite.height);
+            bool passed = withinTolerance(comparison, suite.tolerance);
+            logComparison(log, regressionCase.name + " (views)", passed, comparison);
+            if (!passed) {
+                failed++;
+            }
+        }
+    }
+    return failed;
+}
+
+int runRegression(const RegressionSuite& suite, const std::string& referenceDir, bool update, bool useGpu,
+    const std::function<void(RayTracer&)>& configureGpu, const std::function<void(CpuRayTracer&)>& configureCpu,
+    std::ostream& log)
+{
+    int failed = 0;
+    // what every case rendered on the gpu, for checkViews
+    std::vector<RenderCamera> cameras(suite.cases.size());
+    std::vector<std::vector<glm::vec4>> images(suite.cases.size());
+    bool renderedOnGpu = false;
+    for (size_t caseIndex = 0; caseIndex < suite.cases.size(); caseIndex++) {
+        const RegressionCase& regressionCase = suite.cases[caseIndex];
+        std::string referencePath = referenceDir + "/" + regressionCase.name + ".pfm";
+
+        Scene scene;
+        double loadMs = 0.0;
+        double buildMs = 0.0;
+        if (!loadBenchmarkScene(regressionCase.scene, scene, loadMs, buildMs)) {
+            log << regressionCase.name << ": could not load " << regressionCase.scene << std::endl;
+            failed++;
+            continue;
+        }
+        RenderCamera camera = regressionCase.orbit ? orbitPath(scene, 8)[1] : regressionCase.camera;
+
+        OfflineRenderer renderer(suite.width, suite.height, std::move(scene), !useGpu);
+        if (renderer.onGpu()) {
+            configureGpu(*renderer.getRayTracer());
+        } else {
+            configureCpu(*renderer.getCpuRayTracer());
+        }
+        std::vector<glm::vec4> image = averageAccumulation(renderer.render(camera, suite.samples));
+        if (renderer.onGpu()) {
+            renderedOnGpu = true;
+            cameras[caseIndex] = camera;
+            images[caseIndex] = image;
+        }
+
+        if (update) {
+            if (!writeImage(referencePath, suite.width, suite.height, image)) {
+                failed++;
+                continue;
+            }
+            log << regressionCase.name << ": reference written to " << referencePath << std::endl;
+            continue;
+        }
+
+        int width = 0;
+        int height = 0;
+        std::vector<glm::vec4> reference;
+        if (!readImage(referencePath, width, height, reference)) {
+            log << regressionCase.name << ": no reference to compare with, render the references first" << std::endl;
+            failed++;
+            continue;
+        }
+        if (width != suite.width || height != suite.height) {
+            log << regressionCase.name << ": reference is " << width << "x" << height << ", the suite renders "
+                << suite.width << "x" << suite.height << std::endl;
+            failed++;
+            continue;
+        }
+
+        ImageComparison comparison = compareImages(reference, image, width, height);
+        bool passed = withinTolerance(comparison, suite.tolerance);
+
+        logComparison(log, regressionCase.name, passed, comparison);
+
+        if (!passed) {
+            failed++;
+            std::vector<glm::vec4> errorImage(comparison.errorMap.size());
+            for (size_t i = 0; i < errorImage.size(); i++) {
+                float e = comparison.errorMap[i];
+                errorImage[i] = glm::vec4(e, e, e, 1.0f);
+            }
+            writeImage(referenceDir + "/" + regressionCase.name + ".new.pfm", width, height, image);
+            writeImage(referenceDir + "/" + regressionCase.name + ".diff.ppm", width, height, errorImage);
+        }
+    }
+
+    if (!update) {
+        log << (suite.cases.size() - size_t(failed)) << " of " << suite.cases.size() << " images match their references" << std::endl;
+        if (renderedOnGpu) {
+            int viewsFailed = checkViews(suite, configureGpu, cameras, images, log);
+            failed += viewsFailed;
+            if (viewsFailed > 0) {
+                log << viewsFailed << " views differ from the single camera renders" << std::endl;
+            }
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,71 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include "CpuRayTracer.h"
+#include "RayTracer.h"
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// one canonical image, always rendered from sample 0 so the sampler seeds are the same every run
+struct RegressionCase {
+    std::string name;
+    // same as BenchmarkCase::scene
+    std::string scene;
+    // true frames the scene like the benchmark orbit does, camera is used otherwise
+    bool orbit;
+    RenderCamera camera;
+};
+
+// how far an image may move before it counts as a regression. the defaults let through the odd
+// path that goes elsewhere after a change in float rounding (another compiler, fma) but not a
+// change of sampling or a wrong hit, which moves every pixel
+struct RegressionTolerance {
+    double rmse = 0.002;
+    double meanError = 0.0002;
+    // share of the pixels whose error is above 0.1
+    double errorPixels = 0.001;
+};
+
+struct RegressionSuite {
+    int width = 160;
+    int height = 120;
+    int samples = 16;
+    RegressionTolerance tolerance;
+    std::vector<RegressionCase> cases;
+};
+
+// how two images differ once they are on screen (clamped like the window shows them)
+struct ImageComparison {
+    // over the rgb of every pixel
+    double rmse;
+    // mean and max of the per pixel error in [0, 1], a simplified FLIP: both images are blurred
+    // a little like the eye does at a normal viewing distance, then compared in CIELAB with the
+    // HyAB distance, which weighs lightness apart from hue and saturation
+    double meanError;
+    double maxError;
+    double errorPixels;
+    std::vector<float> errorMap;
+};
+
+// the default scene from the window's camera and from the side, the bunnies and a synthetic grid
+RegressionSuite defaultRegressionSuite();
+
+// images of the same size, row 0 at the bottom
+ImageComparison compareImages(const std::vector<glm::vec4>& reference, const std::vector<glm::vec4>& image, int width, int height);
+
+// Renders every case and compares it against referenceDir/<name>.pfm, on the cpu unless useGpu
+// is set and a context can be made (llvmpipe is fine, the gpu traces the same paths). configure
+// gets the tracer like everywhere else, so a traversal or sampling change can be checked with
+// the switches that turn it on. A case that fails leaves <name>.new.pfm with the image and
+// <name>.diff.ppm with its error map next to the reference, a case without a reference fails
+// too. update writes the references instead, the directory has to exist. the default suite's
+// references live in tests/reference. on the gpu the cases of every scene are then rendered
+// together through RayTracer::renderViews as well and each view has to match its single camera
+// image. returns how many cases or views failed or could not be rendered
+int runRegression(const RegressionSuite& suite, const std::string& referenceDir, bool update, bool useGpu,
+    const std::function<void(RayTracer&)>& configureGpu, const std::function<void(CpuRayTracer&)>& configureCpu,
+    std::ostream& log);
+
+#endif // REGRESSION_H
@@ -0,0 +1,99 @@
+#include "Sampler.h"
+
+// see shaders/sampler.glsl for the reasoning behind each of these
+
+uint32_t wangHash(uint32_t seed) {
+    seed = (seed ^ 61u) ^ (seed >> 16u);
+    seed *= 9u;
+    seed = seed ^ (seed >> 4u);
+    seed *= 0x27d4eb2du;
+    seed = seed ^ (seed >> 15u);
+    return seed;
+}
+
+uint32_t generateSeed(uint32_t pixelX, uint32_t pixelY, uint32_t frame, uint32_t invocationId) {
+    uint32_t seed = pixelX;
+    seed = wangHash(seed ^ pixelY);
+    seed = wangHash(seed ^ frame);
+    seed = wangHash(seed ^ invocationId);
+    seed = wangHash(seed ^ (pixelX / 16u));
+    seed = wangHash(seed ^ (pixelY / 16u));
+    return seed;
+}
+
+float randomValue(uint32_t& state) {
+    state = wangHash(state);
+    state = state * 747796405u + 2891336453u;
+    uint32_t result = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    result = (result >> 22u) ^ result;
+    // glsl divides in single precision too
+    return static_cast<float>(result) / 4294967295.0f;
+}
+
+static const uint32_t sobolDirections[128] = {
+    // dimension 0
+    0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+    0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+    0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+    0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+    // dimension 1
+    0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+    0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+    0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+    0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+    // dimension 2
+    0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+    0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+    0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+    0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+    // dimension 3
+    0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+    0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+    0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+    0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+};
+
+static uint32_t sobol(uint32_t index, uint32_t dim) {
+    uint32_t result = 0;
+    for (uint32_t bit = 0; index != 0; bit++, index >>= 1) {
+        if (index & 1u) {
+            result ^= sobolDirections[dim * 32u + bit];
+        }
+    }
+    return result;
+}
+
+static uint32_t hashCombine(uint32_t seed, uint32_t value) {
+    return seed ^ (value + (seed << 6u) + (seed >> 2u));
+}
+
+static uint32_t reverseBits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+static uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+    x = reverseBits(x);
+    x = laineKarrasPermutation(x, seed);
+    return reverseBits(x);
+}
+
+float sobolOwen(uint32_t index, uint32_t dimension, uint32_t seed) {
+    uint32_t groupSeed = hashCombine(seed, wangHash(dimension / 4u));
+    uint32_t shuffled = nestedUniformScramble(index, groupSeed);
+    uint32_t component = dimension % 4u;
+    uint32_t x = nestedUniformScramble(sobol(shuffled, component), hashCombine(groupSeed, component + 1u));
+    return static_cast<float>(x >> 8u) / 16777216.0f;
+}
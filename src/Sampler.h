@@ -0,0 +1,39 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+
+// cpu copy of shaders/sampler.glsl, every function here produces the same bits as its
+// glsl counterpart so the cpu renderer walks the exact same random sequences
+
+enum class SamplerType {
+    Random = 0, // wang_hash + pcg white noise, one independent stream per pixel and frame
+    Sobol = 1   // owen scrambled sobol indexed by (pixel, sample index, dimension)
+};
+
+uint32_t wangHash(uint32_t seed);
+uint32_t generateSeed(uint32_t pixelX, uint32_t pixelY, uint32_t frame, uint32_t invocationId);
+float randomValue(uint32_t& state);
+float sobolOwen(uint32_t index, uint32_t dimension, uint32_t seed);
+
+struct SamplerState {
+    SamplerType type;
+    uint32_t rng;         // used by SamplerType::Random
+    uint32_t pixelSeed;   // per pixel scramble, constant over frames
+    uint32_t sampleIndex; // how many samples the pixel already has
+    uint32_t dimension;
+
+    SamplerState()
+        : type(SamplerType::Random), rng(0), pixelSeed(0), sampleIndex(0), dimension(0) {}
+    SamplerState(SamplerType type, uint32_t rng, uint32_t pixelSeed, uint32_t sampleIndex)
+        : type(type), rng(rng), pixelSeed(pixelSeed), sampleIndex(sampleIndex), dimension(0) {}
+
+    float next() {
+        if (type == SamplerType::Sobol) {
+            return sobolOwen(sampleIndex, dimension++, pixelSeed);
+        }
+        return randomValue(rng);
+    }
+};
+
+#endif // SAMPLER_H
@@ -0,0 +1,110 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Material::type, same as MATERIAL_* in shaders/scene.glsl
+#define MATERIAL_LAMBERTIAN 0
+#define MATERIAL_EMISSIVE 1
+
+struct Material {
+    glm::vec3 color;
+    int type; // MATERIAL_LAMBERTIAN or MATERIAL_EMISSIVE
+};
+
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+    Material material;
+};
+
+struct Triangle {
+    glm::vec3 v0, v1, v2;
+    glm::vec3 normal;
+    Material material;
+};
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+    
+    AABB() : min(1e30f), max(-1e30f) {}
+    AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+    
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    
+    void expand(const AABB& box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+    
+    glm::vec3 center() const {
+        return (min + max) * 0.5f;
+    }
+    
+    float surfaceArea() const {
+        glm::vec3 extent = max - min;
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+};
+
+struct BVHNode {
+    AABB bounds;
+    int leftChild;   // Index to left child node -1 if leaf
+    int rightChild;  // Index to right child node -1 if leaf
+    int firstTriIndex; // Index of first triangle in leaf nodes
+    int triCount;    // Number of triangles in leaf nodes
+
+    BVHNode() : leftChild(-1), rightChild(-1), firstTriIndex(0), triCount(0) {}
+    
+    bool isLeaf() const {
+        return leftChild == -1 && rightChild == -1;
+    }
+};
+
+// Geometry and its BVH, no GL in here so the cpu renderer and tools can load scenes
+// on machines without a gpu. RayTracer uploads a Scene into its SSBOs
+class Scene {
+public:
+    Scene();
+
+    // the back wall, floor and ceiling with the cube and the bunny, BVH already built
+    static Scene defaultScene();
+
+    void setSpheres(const std::vector<Sphere>& newSpheres) { spheres = newSpheres; }
+    const std::vector<Sphere>& getSpheres() const { return spheres; }
+
+    // replaces all triangles and rebuilds the BVH
+    void setTriangles(const std::vector<Triangle>& newTriangles);
+    const std::vector<Triangle>& getTriangles() const { return triangles; }
+
+    // triangles together with a BVH built for them elsewhere (a render coordinator sending
+    // its scene to workers), nothing is rebuilt
+    void setPrebuilt(const std::vector<Triangle>& newTriangles, const std::vector<BVHNode>& nodes,
+        const std::vector<int>& indices);
+
+    // appends the mesh, call buildBVH once everything is loaded
+    bool loadOBJ(const std::string& filename, const Material& material = {{0.8f, 0.8f, 0.8f}, 0});
+
+    void buildBVH();
+    const std::vector<BVHNode>& getBVHNodes() const { return bvhNodes; }
+    // leaves reference triangles through this list, node.firstTriIndex indexes into it
+    const std::vector<int>& getTriangleIndices() const { return triangleIndices; }
+
+private:
+    std::vector<Sphere> spheres;
+    std::vector<Triangle> triangles;
+    std::vector<BVHNode> bvhNodes;
+    std::vector<int> triangleIndices;
+
+    AABB computeTriangleAABB(const Triangle& tri);
+    glm::vec3 computeTriangleCentroid(const Triangle& tri);
+    int buildBVHRecursive(int start, int end, std::vector<int>& indices, const std::vector<glm::vec3>& centroids);
+};
+
+#endif // SCENE_H
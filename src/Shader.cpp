@@ -51,24 +51,42 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     glDeleteShader(fragment);
 }
 
+// reads a shader file and pastes in every #include "file" line, the included path
+// is relative to the file that includes it
+std::string Shader::loadSource(const std::string& path)
+{
+    std::ifstream shaderFile;
+    shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+    shaderFile.open(path);
+    std::stringstream shaderStream;
+    shaderStream << shaderFile.rdbuf();
+    shaderFile.close();
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+    std::string source;
+    std::string line;
+    std::istringstream lines(shaderStream.str());
+    while (std::getline(lines, line)) {
+        size_t directive = line.find_first_not_of(" \t");
+        if (directive != std::string::npos && line.compare(directive, 8, "#include") == 0) {
+            size_t first = line.find('"', directive);
+            size_t last = line.find('"', first + 1);
+            source += loadSource(directory + line.substr(first + 1, last - first - 1));
+            continue;
+        }
+        source += line + "\n";
+    }
+    return source;
+}
+
 // compute shader
 Shader::Shader(const char* computePath)
 {
     computeShader = true;
     
-    std::string computeCode;
-    std::ifstream cShaderFile;
-    
-    cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    
-    cShaderFile.open(computePath);
-    std::stringstream cShaderStream;
-    
-    cShaderStream << cShaderFile.rdbuf();
-    
-    cShaderFile.close();
-    
-    computeCode = cShaderStream.str();
+    // compute shaders share code (random numbers, intersection) through #include
+    std::string computeCode = loadSource(computePath);
     
     const char* cShaderCode = computeCode.c_str();
     
@@ -95,12 +113,22 @@ void Shader::setInt(const std::string &name, int value) const
     glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
 }
 
+void Shader::setFloat(const std::string &name, float value) const
+{
+    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+}
+
 // for the resolution
 void Shader::setVec2(const std::string &name, const glm::vec2& value) const
 {
     glUniform2f(glGetUniformLocation(ID, name.c_str()), value.x, value.y);
 }
 
+void Shader::setIVec2(const std::string &name, const glm::ivec2& value) const
+{
+    glUniform2i(glGetUniformLocation(ID, name.c_str()), value.x, value.y);
+}
+
 // utility function to set vec3 uniforms in the shader,
 // it is being used for camera positions but will be used in other things obviously
 // why im wrting so many comments though
@@ -113,3 +141,8 @@ void Shader::dispatchCompute(GLuint numGroupsX, GLuint numGroupsY, GLuint numGro
 {    
     glDispatchCompute(numGroupsX, numGroupsY, numGroupsZ);
 }
+
+void Shader::dispatchComputeIndirect(GLintptr offset) const
+{
+    glDispatchComputeIndirect(offset);
+}
@@ -15,16 +15,22 @@ public:
     
     void use() const;
     void setInt(const std::string& name, int value) const;
+    void setFloat(const std::string& name, float value) const;
     void setVec2(const std::string& name, const glm::vec2& value) const;
+    void setIVec2(const std::string& name, const glm::ivec2& value) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
     
     void dispatchCompute(GLuint numGroupsX, GLuint numGroupsY, GLuint numGroupsZ) const;
+    // group counts are read from the buffer bound to GL_DISPATCH_INDIRECT_BUFFER
+    void dispatchComputeIndirect(GLintptr offset) const;
     
     GLuint getID() const { return ID; }
     
 private:
     GLuint ID;
     bool computeShader;
+
+    static std::string loadSource(const std::string& path);
 };
 
 #endif // SHADER_H
@@ -0,0 +1,139 @@
+#include "Simd.h"
+#include "PacketTracer.h"
+#include "WideBVH.h"
+#include "SimdKernels.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+// portable fallback, plain loops the compiler may or may not vectorize
+struct ScalarMask {
+    int m;
+    ScalarMask operator&(const ScalarMask& o) const { return { m & o.m }; }
+    ScalarMask operator|(const ScalarMask& o) const { return { m | o.m }; }
+};
+
+struct ScalarLanes {
+    typedef ScalarMask Mask;
+    static const int width = 4;
+    float v[4];
+
+    static ScalarLanes set1(float x) { return { { x, x, x, x } }; }
+    static ScalarLanes load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+    static void store(float* p, const ScalarLanes& a) {
+        for (int i = 0; i < width; i++) p[i] = a.v[i];
+    }
+
+    ScalarLanes operator+(const ScalarLanes& o) const { ScalarLanes r; for (int i = 0; i < width; i++) r.v[i] = v[i] + o.v[i]; return r; }
+    ScalarLanes operator-(const ScalarLanes& o) const { ScalarLanes r; for (int i = 0; i < width; i++) r.v[i] = v[i] - o.v[i]; return r; }
+    ScalarLanes operator*(const ScalarLanes& o) const { ScalarLanes r; for (int i = 0; i < width; i++) r.v[i] = v[i] * o.v[i]; return r; }
+    ScalarLanes operator/(const ScalarLanes& o) const { ScalarLanes r; for (int i = 0; i < width; i++) r.v[i] = v[i] / o.v[i]; return r; }
+
+    static Mask lt(const ScalarLanes& a, const ScalarLanes& b) { Mask r = { 0 }; for (int i = 0; i < width; i++) r.m |= int(a.v[i] < b.v[i]) << i; return r; }
+    static Mask gt(const ScalarLanes& a, const ScalarLanes& b) { Mask r = { 0 }; for (int i = 0; i < width; i++) r.m |= int(a.v[i] > b.v[i]) << i; return r; }
+    static Mask ge(const ScalarLanes& a, const ScalarLanes& b) { Mask r = { 0 }; for (int i = 0; i < width; i++) r.m |= int(a.v[i] >= b.v[i]) << i; return r; }
+    static ScalarLanes select(const Mask& mask, const ScalarLanes& a, const ScalarLanes& b) {
+        ScalarLanes r;
+        for (int i = 0; i < width; i++) r.v[i] = (mask.m >> i) & 1 ? a.v[i] : b.v[i];
+        return r;
+    }
+    static int bits(const Mask& mask) { return mask.m; }
+    static Mask maskFromBits(int bits) { return { bits }; }
+};
+
+}
+
+void intersectPacketScalar(const PacketBVH& bvh, RayPacket& packet) {
+    intersectPacketKernel<ScalarLanes>(bvh, packet);
+}
+
+bool intersectWideScalar(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle) {
+    return intersectWideKernel<ScalarLanes>(bvh, origin, dir, tMin, tMax, hitTriangle);
+}
+
+#ifdef SIMD_X86
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, int(leaf), int(subleaf));
+    for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(r[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// which register states the os saves on a context switch
+static unsigned long long xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+const char* simdIsaName(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::Sse: return "sse";
+    case SimdIsa::Avx2: return "avx2";
+    case SimdIsa::Avx512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+bool isSimdIsaSupported(SimdIsa isa) {
+    if (isa == SimdIsa::Scalar) {
+        return true;
+    }
+#ifdef SIMD_X86
+    if (isa == SimdIsa::Sse) {
+        return true; // sse2 is part of x86-64
+    }
+
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 7) {
+        return false;
+    }
+
+    cpuid(1, 0, regs);
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!osxsave || !avx) {
+        return false;
+    }
+    unsigned long long xcr0 = xgetbv0();
+
+    cpuid(7, 0, regs);
+    if (isa == SimdIsa::Avx2) {
+        bool avx2 = (regs[1] & (1u << 5)) != 0;
+        return avx2 && (xcr0 & 0x6) == 0x6;
+    }
+    if (isa == SimdIsa::Avx512) {
+        bool avx512f = (regs[1] & (1u << 16)) != 0;
+        // opmask and both halves of the zmm registers on top of sse and avx
+        return avx512f && (xcr0 & 0xe6) == 0xe6;
+    }
+#endif
+    return false;
+}
+
+SimdIsa detectSimdIsa() {
+    const SimdIsa preferred[] = { SimdIsa::Avx512, SimdIsa::Avx2, SimdIsa::Sse };
+    for (SimdIsa isa : preferred) {
+        if (isSimdIsaSupported(isa)) {
+            return isa;
+        }
+    }
+    return SimdIsa::Scalar;
+}
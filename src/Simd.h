@@ -0,0 +1,27 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// instruction sets the cpu kernels are built for, the best one the cpu has is picked at runtime.
+// every Simd*.cpp compiles the templates in SimdKernels.h for one of them
+enum class SimdIsa {
+    Scalar = 0, // plain c++ over 4 lanes, works everywhere
+    Sse = 1,    // 4 lanes
+    Avx2 = 2,   // 8 lanes
+    Avx512 = 3  // 16 lanes
+};
+
+const char* simdIsaName(SimdIsa isa);
+// checks cpuid and that the os saves the wider registers
+bool isSimdIsaSupported(SimdIsa isa);
+SimdIsa detectSimdIsa();
+
+// what a traversal did, the kernels add to it when their view points to one. a box or triangle
+// test is one ray against one box or triangle, so a packet node counts once per active lane
+// and a wide node once per slot (the empty ones and the padding of triangle blocks included)
+struct TraversalCounts {
+    unsigned long long nodeVisits;    // boxes the ray went into
+    unsigned long long aabbTests;
+    unsigned long long triangleTests;
+};
+
+#endif // SIMD_H
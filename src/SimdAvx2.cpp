@@ -0,0 +1,78 @@
+#include "PacketTracer.h"
+#include "WideBVH.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+
+// only the kernel below is compiled for avx2, the headers above keep the project flags so no
+// inline std or glm function gets emitted with instructions older cpus lack.
+// it is only called after cpuid said the cpu has it
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2")
+#endif
+
+#include "SimdKernels.h"
+
+namespace {
+
+struct Avx2Mask {
+    __m256 m;
+    Avx2Mask operator&(const Avx2Mask& o) const { return { _mm256_and_ps(m, o.m) }; }
+    Avx2Mask operator|(const Avx2Mask& o) const { return { _mm256_or_ps(m, o.m) }; }
+};
+
+struct Avx2Lanes {
+    typedef Avx2Mask Mask;
+    static const int width = 8;
+    __m256 v;
+
+    static Avx2Lanes set1(float x) { return { _mm256_set1_ps(x) }; }
+    static Avx2Lanes load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    static void store(float* p, const Avx2Lanes& a) { _mm256_storeu_ps(p, a.v); }
+
+    Avx2Lanes operator+(const Avx2Lanes& o) const { return { _mm256_add_ps(v, o.v) }; }
+    Avx2Lanes operator-(const Avx2Lanes& o) const { return { _mm256_sub_ps(v, o.v) }; }
+    Avx2Lanes operator*(const Avx2Lanes& o) const { return { _mm256_mul_ps(v, o.v) }; }
+    Avx2Lanes operator/(const Avx2Lanes& o) const { return { _mm256_div_ps(v, o.v) }; }
+
+    static Mask lt(const Avx2Lanes& a, const Avx2Lanes& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    static Mask gt(const Avx2Lanes& a, const Avx2Lanes& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    static Mask ge(const Avx2Lanes& a, const Avx2Lanes& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+    static Avx2Lanes select(const Mask& mask, const Avx2Lanes& a, const Avx2Lanes& b) {
+        return { _mm256_blendv_ps(b.v, a.v, mask.m) };
+    }
+    static int bits(const Mask& mask) { return _mm256_movemask_ps(mask.m); }
+    static Mask maskFromBits(int bits) {
+        const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i set = _mm256_and_si256(_mm256_set1_epi32(bits), laneBits);
+        return { _mm256_castsi256_ps(_mm256_cmpeq_epi32(set, laneBits)) };
+    }
+};
+
+}
+
+void intersectPacketAvx2(const PacketBVH& bvh, RayPacket& packet) {
+    intersectPacketKernel<Avx2Lanes>(bvh, packet);
+}
+
+bool intersectWideAvx2(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle) {
+    return intersectWideKernel<Avx2Lanes>(bvh, origin, dir, tMin, tMax, hitTriangle);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#else
+
+void intersectPacketAvx2(const PacketBVH& bvh, RayPacket& packet) {
+    intersectPacketScalar(bvh, packet);
+}
+
+bool intersectWideAvx2(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle) {
+    return intersectWideScalar(bvh, origin, dir, tMin, tMax, hitTriangle);
+}
+
+#endif
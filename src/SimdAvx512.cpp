@@ -0,0 +1,67 @@
+#include "PacketTracer.h"
+#include "WideBVH.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+
+// only the kernel below is compiled for avx-512, the headers above keep the project flags so no
+// inline std or glm function gets emitted with instructions older cpus lack.
+// it is only called after cpuid said the cpu has it
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#endif
+
+#include "SimdKernels.h"
+
+namespace {
+
+// avx-512 compares straight into a bit mask register
+struct Avx512Mask {
+    __mmask16 m;
+    Avx512Mask operator&(const Avx512Mask& o) const { return { __mmask16(m & o.m) }; }
+    Avx512Mask operator|(const Avx512Mask& o) const { return { __mmask16(m | o.m) }; }
+};
+
+struct Avx512Lanes {
+    typedef Avx512Mask Mask;
+    static const int width = 16;
+    __m512 v;
+
+    static Avx512Lanes set1(float x) { return { _mm512_set1_ps(x) }; }
+    static Avx512Lanes load(const float* p) { return { _mm512_loadu_ps(p) }; }
+    static void store(float* p, const Avx512Lanes& a) { _mm512_storeu_ps(p, a.v); }
+
+    Avx512Lanes operator+(const Avx512Lanes& o) const { return { _mm512_add_ps(v, o.v) }; }
+    Avx512Lanes operator-(const Avx512Lanes& o) const { return { _mm512_sub_ps(v, o.v) }; }
+    Avx512Lanes operator*(const Avx512Lanes& o) const { return { _mm512_mul_ps(v, o.v) }; }
+    Avx512Lanes operator/(const Avx512Lanes& o) const { return { _mm512_div_ps(v, o.v) }; }
+
+    static Mask lt(const Avx512Lanes& a, const Avx512Lanes& b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+    static Mask gt(const Avx512Lanes& a, const Avx512Lanes& b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+    static Mask ge(const Avx512Lanes& a, const Avx512Lanes& b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+    static Avx512Lanes select(const Mask& mask, const Avx512Lanes& a, const Avx512Lanes& b) {
+        return { _mm512_mask_blend_ps(mask.m, b.v, a.v) };
+    }
+    static int bits(const Mask& mask) { return int(mask.m); }
+    static Mask maskFromBits(int bits) { return { __mmask16(bits) }; }
+};
+
+}
+
+void intersectPacketAvx512(const PacketBVH& bvh, RayPacket& packet) {
+    intersectPacketKernel<Avx512Lanes>(bvh, packet);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#else
+
+void intersectPacketAvx512(const PacketBVH& bvh, RayPacket& packet) {
+    intersectPacketScalar(bvh, packet);
+}
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+// The simd traversals written once against a small lane type F, every Simd*.cpp
+// defines F for its instruction set and instantiates the templates. F provides
+//   F::width, F::Mask (with & and |), F::set1, F::load, F::store, + - * /,
+//   F::lt, F::gt, F::ge, F::select(mask, ifSet, ifClear), F::bits, F::maskFromBits
+// nothing in here has external linkage so each file keeps its own copy built for its own isa
+
+#include "PacketTracer.h"
+#include "WideBVH.h"
+
+// a fused multiply add rounds differently than the single ray code, which would break the
+// promise that the kernels find the exact same hits
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace {
+
+template <typename F>
+inline F dot3(const F& ax, const F& ay, const F& az, const F& bx, const F& by, const F& bz) {
+    return ax * bx + ay * by + az * bz;
+}
+
+// one slab of intersectAABB, lo and hi are the running entry and exit distances
+template <typename F>
+inline void slab(const F& boxMin, const F& boxMax, const F& origin, const F& invDir, const typename F::Mask& negative, F& lo, F& hi) {
+    F t0 = (boxMin - origin) * invDir;
+    F t1 = (boxMax - origin) * invDir;
+    F tNear = F::select(negative, t1, t0);
+    F tFar = F::select(negative, t0, t1);
+    // a nan slab keeps the old bound, like the single ray code
+    lo = F::select(F::gt(tNear, lo), tNear, lo);
+    hi = F::select(F::lt(tFar, hi), tFar, hi);
+}
+
+inline int laneCount(int mask) {
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
+
+template <typename F>
+void intersectPacketKernel(const PacketBVH& bvh, RayPacket& packet) {
+    typedef typename F::Mask Mask;
+
+    int hits[MAX_PACKET_WIDTH];
+    for (int i = 0; i < F::width; i++) {
+        hits[i] = -1;
+    }
+
+    int activeMask = packet.activeMask & ((1 << F::width) - 1);
+    if (bvh.nodeCount == 0 || activeMask == 0) {
+        for (int i = 0; i < F::width; i++) {
+            packet.hitTriangle[i] = hits[i];
+        }
+        return;
+    }
+
+    const F originX = F::load(packet.originX);
+    const F originY = F::load(packet.originY);
+    const F originZ = F::load(packet.originZ);
+    const F dirX = F::load(packet.dirX);
+    const F dirY = F::load(packet.dirY);
+    const F dirZ = F::load(packet.dirZ);
+    const F one = F::set1(1.0f);
+    const F zero = F::set1(0.0f);
+    const F invX = one / dirX;
+    const F invY = one / dirY;
+    const F invZ = one / dirZ;
+    const Mask negX = F::lt(invX, zero);
+    const Mask negY = F::lt(invY, zero);
+    const Mask negZ = F::lt(invZ, zero);
+    const F tMin = F::set1(packet.tMin);
+    const F epsilon = F::set1(1e-7f);
+    const F negEpsilon = F::set1(-1e-7f);
+    F closest = F::load(packet.tMax);
+
+    // every entry carries the lanes that reached it, a lane that missed the parent never
+    // sees the children, just like the single ray stack
+    struct StackEntry {
+        int node;
+        int mask;
+    };
+    StackEntry stack[64];
+    int stackPtr = 0;
+    stack[stackPtr++] = { 0, activeMask };
+
+    while (stackPtr > 0) {
+        StackEntry entry = stack[--stackPtr];
+        const float* bounds = bvh.nodeBounds + entry.node * 6;
+
+        F lo = tMin;
+        F hi = closest;
+        slab(F::set1(bounds[0]), F::set1(bounds[3]), originX, invX, negX, lo, hi);
+        slab(F::set1(bounds[1]), F::set1(bounds[4]), originY, invY, negY, lo, hi);
+        slab(F::set1(bounds[2]), F::set1(bounds[5]), originZ, invZ, negZ, lo, hi);
+        int mask = entry.mask & F::bits(F::ge(hi, lo));
+        if (bvh.counts) {
+            bvh.counts->aabbTests += laneCount(entry.mask);
+            bvh.counts->nodeVisits += laneCount(mask);
+        }
+        if (mask == 0) {
+            continue;
+        }
+
+        const int* links = bvh.nodeLinks + entry.node * 4;
+        if (bvh.counts && links[0] == -1 && links[1] == -1) {
+            bvh.counts->triangleTests += (unsigned long long)(laneCount(mask)) * links[3];
+        }
+        if (links[0] == -1 && links[1] == -1) {
+            for (int i = 0; i < links[3]; i++) {
+                int index = links[2] + i;
+                const float* tri = bvh.triangles + index * 9;
+
+                // edges in scalar like glm does them so every lane sees the same values
+                F edge1X = F::set1(tri[3] - tri[0]);
+                F edge1Y = F::set1(tri[4] - tri[1]);
+                F edge1Z = F::set1(tri[5] - tri[2]);
+                F edge2X = F::set1(tri[6] - tri[0]);
+                F edge2Y = F::set1(tri[7] - tri[1]);
+                F edge2Z = F::set1(tri[8] - tri[2]);
+
+                // pvec = cross(dir, edge2)
+                F pX = dirY * edge2Z - edge2Y * dirZ;
+                F pY = dirZ * edge2X - edge2Z * dirX;
+                F pZ = dirX * edge2Y - edge2X * dirY;
+                F det = dot3(edge1X, edge1Y, edge1Z, pX, pY, pZ);
+                Mask parallel = F::gt(det, negEpsilon) & F::lt(det, epsilon);
+
+                F invDet = one / det;
+                F tX = originX - F::set1(tri[0]);
+                F tY = originY - F::set1(tri[1]);
+                F tZ = originZ - F::set1(tri[2]);
+                F u = invDet * dot3(tX, tY, tZ, pX, pY, pZ);
+                Mask outsideU = F::lt(u, zero) | F::gt(u, one);
+
+                // qvec = cross(tvec, edge1)
+                F qX = tY * edge1Z - edge1Y * tZ;
+                F qY = tZ * edge1X - edge1Z * tX;
+                F qZ = tX * edge1Y - edge1X * tY;
+                F v = invDet * dot3(dirX, dirY, dirZ, qX, qY, qZ);
+                Mask outsideV = F::lt(v, zero) | F::gt(u + v, one);
+
+                F t = invDet * dot3(edge2X, edge2Y, edge2Z, qX, qY, qZ);
+                Mask outsideT = F::lt(t, tMin) | F::gt(t, closest);
+
+                int rejected = F::bits(parallel | outsideU | outsideV | outsideT);
+                int hitMask = mask & ~rejected & F::bits(F::lt(t, closest));
+                if (hitMask != 0) {
+                    closest = F::select(F::maskFromBits(hitMask), t, closest);
+                    for (int lane = 0; lane < F::width; lane++) {
+                        if (hitMask & (1 << lane)) {
+                            hits[lane] = bvh.triangleIndices[index];
+                        }
+                    }
+                }
+            }
+        } else {
+            // right first for left-to-right traversal
+            if (links[1] != -1) {
+                stack[stackPtr++] = { links[1], mask };
+            }
+            if (links[0] != -1) {
+                stack[stackPtr++] = { links[0], mask };
+            }
+        }
+    }
+
+    F::store(packet.tMax, closest);
+    for (int i = 0; i < F::width; i++) {
+        packet.hitTriangle[i] = hits[i];
+    }
+}
+
+
+// one ray against the W children of a wide node at a time, leaves hold their triangles in
+// blocks of W so a whole block is tested at once. children are visited in the order the
+// binary bvh had them and a block keeps the earliest of equally close triangles, so the ray
+// tests the binary traversal's triangles in the same order and ends on the same hit
+template <typename F>
+bool intersectWideKernel(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle) {
+    typedef typename F::Mask Mask;
+    const int width = F::width;
+    if (bvh.nodeCount == 0) {
+        return false;
+    }
+
+    const F originX = F::set1(origin[0]);
+    const F originY = F::set1(origin[1]);
+    const F originZ = F::set1(origin[2]);
+    const F dirX = F::set1(dir[0]);
+    const F dirY = F::set1(dir[1]);
+    const F dirZ = F::set1(dir[2]);
+    const F one = F::set1(1.0f);
+    const F zero = F::set1(0.0f);
+    // the reciprocal in scalar like intersectAABB does it
+    const F invX = F::set1(1.0f / dir[0]);
+    const F invY = F::set1(1.0f / dir[1]);
+    const F invZ = F::set1(1.0f / dir[2]);
+    const Mask negX = F::lt(invX, zero);
+    const Mask negY = F::lt(invY, zero);
+    const Mask negZ = F::lt(invZ, zero);
+    const F tMinLanes = F::set1(tMin);
+    const F epsilon = F::set1(1e-7f);
+    const F negEpsilon = F::set1(-1e-7f);
+    const int laneMask = (1 << width) - 1;
+
+    float closest = tMax;
+    bool hitSomething = false;
+
+    // count > 0 marks a leaf, index is then its first triangle block
+    struct StackEntry {
+        int index;
+        int count;
+    };
+    StackEntry stack[256];
+    int stackPtr = 0;
+    stack[stackPtr++] = { 0, 0 };
+
+    while (stackPtr > 0) {
+        StackEntry entry = stack[--stackPtr];
+        if (bvh.counts) {
+            bvh.counts->nodeVisits++;
+            bvh.counts->aabbTests += entry.count > 0 ? 0 : width;
+            bvh.counts->triangleTests += (unsigned long long)(entry.count) * width;
+        }
+
+        if (entry.count > 0) {
+            for (int b = 0; b < entry.count; b++) {
+                int block = entry.index + b;
+                const float* tri = bvh.triangleBlocks + block * 9 * width;
+                F v0X = F::load(tri);
+                F v0Y = F::load(tri + width);
+                F v0Z = F::load(tri + 2 * width);
+                F edge1X = F::load(tri + 3 * width);
+                F edge1Y = F::load(tri + 4 * width);
+                F edge1Z = F::load(tri + 5 * width);
+                F edge2X = F::load(tri + 6 * width);
+                F edge2Y = F::load(tri + 7 * width);
+                F edge2Z = F::load(tri + 8 * width);
+                F closestLanes = F::set1(closest);
+
+                // padding lanes have zero edges, so their det is zero and they drop out here
+                F pX = dirY * edge2Z - edge2Y * dirZ;
+                F pY = dirZ * edge2X - edge2Z * dirX;
+                F pZ = dirX * edge2Y - edge2X * dirY;
+                F det = dot3(edge1X, edge1Y, edge1Z, pX, pY, pZ);
+                Mask parallel = F::gt(det, negEpsilon) & F::lt(det, epsilon);
+
+                F invDet = one / det;
+                F tX = originX - v0X;
+                F tY = originY - v0Y;
+                F tZ = originZ - v0Z;
+                F u = invDet * dot3(tX, tY, tZ, pX, pY, pZ);
+                Mask outsideU = F::lt(u, zero) | F::gt(u, one);
+
+                F qX = tY * edge1Z - edge1Y * tZ;
+                F qY = tZ * edge1X - edge1Z * tX;
+                F qZ = tX * edge1Y - edge1X * tY;
+                F v = invDet * dot3(dirX, dirY, dirZ, qX, qY, qZ);
+                Mask outsideV = F::lt(v, zero) | F::gt(u + v, one);
+
+                F t = invDet * dot3(edge2X, edge2Y, edge2Z, qX, qY, qZ);
+                Mask outsideT = F::lt(t, tMinLanes) | F::gt(t, closestLanes);
+
+                int hitMask = ~F::bits(parallel | outsideU | outsideV | outsideT) & F::bits(F::lt(t, closestLanes)) & laneMask;
+                if (hitMask != 0) {
+                    float distances[16];
+                    F::store(distances, t);
+                    for (int lane = 0; lane < width; lane++) {
+                        if ((hitMask & (1 << lane)) && distances[lane] < closest) {
+                            closest = distances[lane];
+                            hitTriangle = bvh.blockTriangles[block * width + lane];
+                            hitSomething = true;
+                        }
+                    }
+                }
+            }
+            continue;
+        }
+
+        const float* bounds = bvh.nodeBounds + entry.index * 6 * width;
+        F lo = tMinLanes;
+        F hi = F::set1(closest);
+        slab(F::load(bounds), F::load(bounds + 3 * width), originX, invX, negX, lo, hi);
+        slab(F::load(bounds + width), F::load(bounds + 4 * width), originY, invY, negY, lo, hi);
+        slab(F::load(bounds + 2 * width), F::load(bounds + 5 * width), originZ, invZ, negZ, lo, hi);
+        int mask = F::bits(F::ge(hi, lo));
+
+        // pushed backwards so the first child comes off the stack first
+        const int* children = bvh.nodeChildren + entry.index * 2 * width;
+        for (int i = width - 1; i >= 0; i--) {
+            if ((mask & (1 << i)) && children[i] != -1) {
+                stack[stackPtr++] = { children[i], children[width + i] };
+            }
+        }
+    }
+
+    tMax = closest;
+    return hitSomething;
+}
+
+}
+
+#endif // SIMD_KERNELS_H
@@ -0,0 +1,66 @@
+#include "PacketTracer.h"
+#include "WideBVH.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+
+// sse2 is part of x86-64, so this one needs no target flags
+#include "SimdKernels.h"
+
+namespace {
+
+struct SseMask {
+    __m128 m;
+    SseMask operator&(const SseMask& o) const { return { _mm_and_ps(m, o.m) }; }
+    SseMask operator|(const SseMask& o) const { return { _mm_or_ps(m, o.m) }; }
+};
+
+struct SseLanes {
+    typedef SseMask Mask;
+    static const int width = 4;
+    __m128 v;
+
+    static SseLanes set1(float x) { return { _mm_set1_ps(x) }; }
+    static SseLanes load(const float* p) { return { _mm_loadu_ps(p) }; }
+    static void store(float* p, const SseLanes& a) { _mm_storeu_ps(p, a.v); }
+
+    SseLanes operator+(const SseLanes& o) const { return { _mm_add_ps(v, o.v) }; }
+    SseLanes operator-(const SseLanes& o) const { return { _mm_sub_ps(v, o.v) }; }
+    SseLanes operator*(const SseLanes& o) const { return { _mm_mul_ps(v, o.v) }; }
+    SseLanes operator/(const SseLanes& o) const { return { _mm_div_ps(v, o.v) }; }
+
+    static Mask lt(const SseLanes& a, const SseLanes& b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+    static Mask gt(const SseLanes& a, const SseLanes& b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+    static Mask ge(const SseLanes& a, const SseLanes& b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+    static SseLanes select(const Mask& mask, const SseLanes& a, const SseLanes& b) {
+        return { _mm_or_ps(_mm_and_ps(mask.m, a.v), _mm_andnot_ps(mask.m, b.v)) };
+    }
+    static int bits(const Mask& mask) { return _mm_movemask_ps(mask.m); }
+    static Mask maskFromBits(int bits) {
+        const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+        __m128i set = _mm_and_si128(_mm_set1_epi32(bits), laneBits);
+        return { _mm_castsi128_ps(_mm_cmpeq_epi32(set, laneBits)) };
+    }
+};
+
+}
+
+void intersectPacketSse(const PacketBVH& bvh, RayPacket& packet) {
+    intersectPacketKernel<SseLanes>(bvh, packet);
+}
+
+bool intersectWideSse(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle) {
+    return intersectWideKernel<SseLanes>(bvh, origin, dir, tMin, tMax, hitTriangle);
+}
+
+#else
+
+void intersectPacketSse(const PacketBVH& bvh, RayPacket& packet) {
+    intersectPacketScalar(bvh, packet);
+}
+
+bool intersectWideSse(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle) {
+    return intersectWideScalar(bvh, origin, dir, tMin, tMax, hitTriangle);
+}
+
+#endif
@@ -0,0 +1,262 @@
+#include "TileScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// interleaves the bits of x and y
+static uint32_t mortonCode(uint32_t x, uint32_t y) {
+    auto spread = [](uint32_t v) {
+        v &= 0x0000ffffu;
+        v = (v | (v << 8)) & 0x00ff00ffu;
+        v = (v | (v << 4)) & 0x0f0f0f0fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        v = (v | (v << 1)) & 0x55555555u;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+// distance of (x, y) along the hilbert curve filling an n * n grid, n a power of two
+static uint32_t hilbertIndex(uint32_t n, uint32_t x, uint32_t y) {
+    uint32_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+        // rotate the quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+// one per thread, the owner pops from the front and thieves take from the back
+struct TileQueue {
+    std::mutex mutex;
+    std::deque<Tile> tiles;
+};
+
+TileScheduler::TileScheduler()
+    : tileSize(16), tileOrder(TileOrder::Hilbert), threadCount(0), runSeconds(0.0),
+      generation(0), work(nullptr), workThreads(0), pendingWorkers(0), stopping(false)
+{
+}
+
+TileScheduler::~TileScheduler() {
+    stopWorkers();
+}
+
+void TileScheduler::startWorkers(int count) {
+    stopWorkers();
+    for (int i = 1; i <= count; i++) {
+        workers.emplace_back(&TileScheduler::workerLoop, this, i);
+    }
+}
+
+void TileScheduler::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    workers.clear();
+    stopping = false;
+}
+
+void TileScheduler::workerLoop(int id) {
+    unsigned long long seen = 0;
+    while (true) {
+        const std::function<void(int)>* current;
+        {
+            std::unique_lock<std::mutex> lock(workMutex);
+            workReady.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            // a run with fewer tiles than threads leaves the rest asleep
+            if (id >= workThreads) {
+                continue;
+            }
+            current = work;
+        }
+        (*current)(id);
+        std::lock_guard<std::mutex> lock(workMutex);
+        if (--pendingWorkers == 0) {
+            workDone.notify_one();
+        }
+    }
+}
+
+void TileScheduler::resetStats() {
+    stats.clear();
+    runSeconds = 0.0;
+}
+
+int TileScheduler::getThreadCount() const {
+    if (threadCount > 0) {
+        return threadCount;
+    }
+    return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+std::vector<Tile> TileScheduler::buildTiles(int width, int height) const {
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    uint32_t gridSize = 1;
+    while (gridSize < uint32_t(std::max(tilesX, tilesY))) {
+        gridSize *= 2;
+    }
+
+    std::vector<std::pair<uint32_t, Tile>> keyed;
+    keyed.reserve(size_t(tilesX) * tilesY);
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            Tile tile = { tx * tileSize, ty * tileSize,
+                std::min((tx + 1) * tileSize, width), std::min((ty + 1) * tileSize, height) };
+            uint32_t key;
+            if (tileOrder == TileOrder::Morton) {
+                key = mortonCode(tx, ty);
+            } else if (tileOrder == TileOrder::Hilbert) {
+                key = hilbertIndex(gridSize, tx, ty);
+            } else {
+                key = uint32_t(ty * tilesX + tx);
+            }
+            keyed.push_back({ key, tile });
+        }
+    }
+    std::sort(keyed.begin(), keyed.end(),
+        [](const std::pair<uint32_t, Tile>& a, const std::pair<uint32_t, Tile>& b) { return a.first < b.first; });
+
+    std::vector<Tile> tiles;
+    tiles.reserve(keyed.size());
+    for (const auto& entry : keyed) {
+        tiles.push_back(entry.second);
+    }
+    return tiles;
+}
+
+void TileScheduler::run(int width, int height, const std::function<void(const Tile&)>& renderTile) {
+    execute(buildTiles(width, height), renderTile);
+}
+
+void TileScheduler::runRange(int count, int chunkSize, const std::function<void(int begin, int end)>& process) {
+    // one row tiles, x is the item index
+    std::vector<Tile> chunks;
+    for (int begin = 0; begin < count; begin += chunkSize) {
+        chunks.push_back({ begin, 0, std::min(begin + chunkSize, count), 1 });
+    }
+    execute(chunks, [&process](const Tile& chunk) { process(chunk.x0, chunk.x1); });
+}
+
+void TileScheduler::execute(const std::vector<Tile>& tiles, const std::function<void(const Tile&)>& renderTile) {
+    auto start = std::chrono::steady_clock::now();
+
+    int threads = std::max(1, std::min(getThreadCount(), int(tiles.size())));
+
+    std::vector<std::unique_ptr<TileQueue>> queues;
+    for (int i = 0; i < threads; i++) {
+        queues.emplace_back(new TileQueue());
+        size_t first = tiles.size() * i / threads;
+        size_t end = tiles.size() * (i + 1) / threads;
+        queues[i]->tiles.assign(tiles.begin() + first, tiles.begin() + end);
+    }
+
+    if (int(stats.size()) < threads) {
+        stats.resize(threads);
+    }
+
+    std::function<void(int)> worker = [&](int id) {
+        TileThreadStats& threadStats = stats[id];
+        while (true) {
+            Tile tile;
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> lock(queues[id]->mutex);
+                if (!queues[id]->tiles.empty()) {
+                    tile = queues[id]->tiles.front();
+                    queues[id]->tiles.pop_front();
+                    found = true;
+                }
+            }
+            // nothing is ever pushed after the start, so one empty sweep over everyone means we are done
+            for (int i = 1; i < threads && !found; i++) {
+                TileQueue& victim = *queues[(id + i) % threads];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tiles.empty()) {
+                    tile = victim.tiles.back();
+                    victim.tiles.pop_back();
+                    found = true;
+                    threadStats.stolen++;
+                }
+            }
+            if (!found) {
+                break;
+            }
+
+            auto tileStart = std::chrono::steady_clock::now();
+            renderTile(tile);
+            threadStats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - tileStart).count();
+            threadStats.tiles++;
+            threadStats.pixels += (long long)(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+        }
+    };
+
+    // the pool keeps one thread per hardware thread (or setThreadCount) besides the caller
+    if (int(workers.size()) != getThreadCount() - 1) {
+        startWorkers(getThreadCount() - 1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        work = &worker;
+        workThreads = threads;
+        pendingWorkers = threads - 1;
+        generation++;
+    }
+    workReady.notify_all();
+    worker(0);
+    {
+        std::unique_lock<std::mutex> lock(workMutex);
+        workDone.wait(lock, [this] { return pendingWorkers == 0; });
+        work = nullptr;
+    }
+
+    runSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& threadStats : stats) {
+        threadStats.utilization = runSeconds > 0.0 ? threadStats.busySeconds / runSeconds : 1.0;
+    }
+}
+
+void TileScheduler::printStats(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    double utilizationSum = 0.0;
+    for (const auto& threadStats : stats) {
+        utilizationSum += threadStats.utilization;
+    }
+    out << std::fixed << std::setprecision(1)
+        << "tiles of " << tileSize << " px on " << stats.size() << " threads, "
+        << runSeconds * 1000.0 << " ms, mean utilization "
+        << (stats.empty() ? 0.0 : 100.0 * utilizationSum / stats.size()) << "%" << std::endl;
+    for (size_t i = 0; i < stats.size(); i++) {
+        out << "  thread " << i << ": " << stats[i].tiles << " tiles (" << stats[i].stolen << " stolen), "
+            << stats[i].pixels << " px, " << 100.0 * stats[i].utilization << "% busy" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
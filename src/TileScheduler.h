@@ -0,0 +1,96 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// order the tiles are dealt out in, the curves keep neighbouring tiles (and the bvh nodes
+// they touch) on the same thread
+enum class TileOrder {
+    Scanline = 0,
+    Morton = 1,
+    Hilbert = 2
+};
+
+// pixel rectangle [x0, x1) x [y0, y1)
+struct Tile {
+    int x0, y0;
+    int x1, y1;
+};
+
+struct TileThreadStats {
+    int tiles = 0;        // tiles this thread rendered, stolen ones included
+    int stolen = 0;       // tiles taken from other threads' queues
+    long long pixels = 0;
+    double busySeconds = 0.0;
+    // busy time over the wall time of the runs, 1 means the thread never waited
+    double utilization = 0.0;
+};
+
+// Splits an image into tiles and renders them on a set of threads. Every thread starts with
+// a contiguous run of tiles along the curve in its own deque, works from the front of it and
+// steals from the back of the others once it runs dry, so a thread that got the sky is not
+// left idle while another one is still stuck in the bunny. The threads are started once and
+// sleep between runs, so the many short passes of a wavefront frame do not pay for starting them
+class TileScheduler {
+public:
+    TileScheduler();
+    ~TileScheduler();
+
+    void setTileSize(int size) { tileSize = size < 1 ? 1 : size; }
+    int getTileSize() const { return tileSize; }
+    void setTileOrder(TileOrder order) { tileOrder = order; }
+    TileOrder getTileOrder() const { return tileOrder; }
+    // 0 uses every hardware thread
+    void setThreadCount(int count) { threadCount = count; }
+    int getThreadCount() const;
+
+    // blocks until renderTile has been called once for every tile of the image,
+    // renderTile is called from several threads at once
+    void run(int width, int height, const std::function<void(const Tile&)>& renderTile);
+    // same for a flat list of work items, process gets [begin, end) ranges of at most chunkSize
+    void runRange(int count, int chunkSize, const std::function<void(int begin, int end)>& process);
+
+    // stats of every run and runRange since resetStats added up, one entry per thread, so a
+    // frame made of several passes is judged as a whole
+    const std::vector<TileThreadStats>& getStats() const { return stats; }
+    // wall time of those runs
+    double getRunSeconds() const { return runSeconds; }
+    void resetStats();
+    void printStats(std::ostream& out) const;
+
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+private:
+    int tileSize;
+    TileOrder tileOrder;
+    int threadCount;
+    std::vector<TileThreadStats> stats;
+    double runSeconds;
+
+    // threads 1 to n - 1, the calling thread is thread 0 of every run. they wait on workReady
+    // for the generation to move and report back on workDone
+    std::vector<std::thread> workers;
+    std::mutex workMutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    unsigned long long generation;
+    // the current run's loop, gets the thread id, and how many threads take part in it
+    const std::function<void(int)>* work;
+    int workThreads;
+    int pendingWorkers;
+    bool stopping;
+
+    std::vector<Tile> buildTiles(int width, int height) const;
+    void execute(const std::vector<Tile>& tiles, const std::function<void(const Tile&)>& renderTile);
+    void startWorkers(int count);
+    void stopWorkers();
+    void workerLoop(int id);
+};
+
+#endif // TILE_SCHEDULER_H
@@ -0,0 +1,55 @@
+#include "ToneMap.h"
+#include <cmath>
+
+// fitted ACES filmic curve (Narkowicz 2015)
+static glm::vec3 acesFilm(const glm::vec3& x) {
+    const float a = 2.51f;
+    const float b = 0.03f;
+    const float c = 2.43f;
+    const float d = 0.59f;
+    const float e = 0.14f;
+    return glm::clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0f, 1.0f);
+}
+
+glm::vec3 toneMap(const glm::vec3& radiance, float exposure, ToneMapper mapper, float gamma) {
+    glm::vec3 color = radiance * std::exp2(exposure);
+    if (mapper == ToneMapper::Reinhard) {
+        color = color / (1.0f + color);
+    } else if (mapper == ToneMapper::Aces) {
+        color = acesFilm(color);
+    } else {
+        color = glm::clamp(color, 0.0f, 1.0f);
+    }
+    return glm::pow(color, glm::vec3(1.0f / gamma));
+}
+
+glm::vec3 heatColor(float t) {
+    t = glm::clamp(t, 0.0f, 1.0f);
+    glm::vec3 low = glm::mix(glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.0f, 0.8f, 1.0f), glm::smoothstep(0.0f, 0.25f, t));
+    glm::vec3 middle = glm::mix(glm::vec3(0.0f, 0.8f, 1.0f), glm::vec3(1.0f, 1.0f, 0.0f), glm::smoothstep(0.25f, 0.6f, t));
+    glm::vec3 high = glm::mix(glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::smoothstep(0.6f, 1.0f, t));
+    return t < 0.25f ? low : (t < 0.6f ? middle : high);
+}
+
+std::vector<glm::vec4> averageAccumulation(const std::vector<glm::dvec4>& accumulation)
+{
+    std::vector<glm::vec4> image(accumulation.size());
+    for (size_t i = 0; i < accumulation.size(); i++) {
+        const glm::dvec4& accum = accumulation[i];
+        glm::vec3 radiance = accum.w > 0.0 ? glm::vec3(glm::dvec3(accum) / accum.w) : glm::vec3(0.0f);
+        image[i] = glm::vec4(radiance, 1.0f);
+    }
+    return image;
+}
+
+std::vector<glm::vec4> toneMapAccumulation(const std::vector<glm::dvec4>& accumulation,
+    float exposure, ToneMapper mapper, float gamma)
+{
+    std::vector<glm::vec4> image(accumulation.size());
+    for (size_t i = 0; i < accumulation.size(); i++) {
+        const glm::dvec4& accum = accumulation[i];
+        glm::vec3 radiance = accum.w > 0.0 ? glm::vec3(glm::dvec3(accum) / accum.w) : glm::vec3(0.0f);
+        image[i] = glm::vec4(toneMap(radiance, exposure, mapper, gamma), 1.0f);
+    }
+    return image;
+}
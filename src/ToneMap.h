@@ -0,0 +1,28 @@
+#ifndef TONE_MAP_H
+#define TONE_MAP_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Operator applied by the tone mapping pass, values match TONEMAP_* in tonemap.comp
+enum class ToneMapper {
+    None = 0,     // clamp to [0, 1]
+    Reinhard = 1,
+    Aces = 2
+};
+
+// cpu version of shaders/tonemap.comp, exposure is in stops
+glm::vec3 toneMap(const glm::vec3& radiance, float exposure, ToneMapper mapper, float gamma);
+
+// heat ramp of the debug views, cpu version of heatColor in shaders/tonemap.glsl. t in [0, 1]
+// goes from dark blue over cyan and yellow to red
+glm::vec3 heatColor(float t);
+
+// mean radiance of every pixel (sum / count, black where nothing was traced), nothing clamped
+std::vector<glm::vec4> averageAccumulation(const std::vector<glm::dvec4>& accumulation);
+
+// turns radiance sums (xyz sum, w sample count) into display colors with alpha 1
+std::vector<glm::vec4> toneMapAccumulation(const std::vector<glm::dvec4>& accumulation,
+    float exposure, ToneMapper mapper, float gamma);
+
+#endif // TONE_MAP_H
@@ -0,0 +1,137 @@
+#include "WideBVH.h"
+
+WideBVH::WideBVH()
+    : isa(SimdIsa::Scalar), width(4)
+{
+}
+
+void WideBVH::build(const Scene& scene, SimdIsa newIsa) {
+    isa = newIsa;
+    width = isa == SimdIsa::Avx2 || isa == SimdIsa::Avx512 ? 8 : 4;
+
+    nodeBounds.clear();
+    nodeChildren.clear();
+    triangleBlocks.clear();
+    blockTriangles.clear();
+
+    if (scene.getBVHNodes().empty()) {
+        return;
+    }
+    collapse(scene, 0);
+}
+
+int WideBVH::collapse(const Scene& scene, int binaryNode) {
+    const std::vector<BVHNode>& nodes = scene.getBVHNodes();
+
+    // keep opening the biggest inner child in place until the node is full, opening in place
+    // keeps the children in the binary tree's left to right order
+    std::vector<int> children;
+    if (nodes[binaryNode].isLeaf()) {
+        children.push_back(binaryNode);
+    } else {
+        children.push_back(nodes[binaryNode].leftChild);
+        children.push_back(nodes[binaryNode].rightChild);
+    }
+    while (int(children.size()) < width) {
+        int widest = -1;
+        float widestArea = -1.0f;
+        for (int i = 0; i < int(children.size()); i++) {
+            const BVHNode& child = nodes[children[i]];
+            if (!child.isLeaf() && child.bounds.surfaceArea() > widestArea) {
+                widest = i;
+                widestArea = child.bounds.surfaceArea();
+            }
+        }
+        if (widest == -1) {
+            break;
+        }
+        const BVHNode& opened = nodes[children[widest]];
+        children[widest] = opened.rightChild;
+        children.insert(children.begin() + widest, opened.leftChild);
+    }
+
+    int nodeIndex = int(nodeChildren.size()) / (2 * width);
+    nodeBounds.resize(nodeBounds.size() + 6 * width);
+    nodeChildren.resize(nodeChildren.size() + 2 * width);
+    for (int i = 0; i < width; i++) {
+        // inverted boxes for the empty slots, no ray ever gets through them
+        float* bounds = &nodeBounds[nodeIndex * 6 * width];
+        bounds[i] = bounds[width + i] = bounds[2 * width + i] = 1e30f;
+        bounds[3 * width + i] = bounds[4 * width + i] = bounds[5 * width + i] = -1e30f;
+        nodeChildren[nodeIndex * 2 * width + i] = -1;
+        nodeChildren[nodeIndex * 2 * width + width + i] = 0;
+    }
+
+    for (int i = 0; i < int(children.size()); i++) {
+        const BVHNode& child = nodes[children[i]];
+        int index, count;
+        if (child.isLeaf()) {
+            index = addLeaf(scene, child);
+            count = (child.triCount + width - 1) / width;
+        } else {
+            index = collapse(scene, children[i]);
+            count = 0;
+        }
+
+        // collapse may have grown the arrays, so index them again
+        float* bounds = &nodeBounds[nodeIndex * 6 * width];
+        bounds[i] = child.bounds.min.x;
+        bounds[width + i] = child.bounds.min.y;
+        bounds[2 * width + i] = child.bounds.min.z;
+        bounds[3 * width + i] = child.bounds.max.x;
+        bounds[4 * width + i] = child.bounds.max.y;
+        bounds[5 * width + i] = child.bounds.max.z;
+        nodeChildren[nodeIndex * 2 * width + i] = index;
+        nodeChildren[nodeIndex * 2 * width + width + i] = count;
+    }
+    return nodeIndex;
+}
+
+int WideBVH::addLeaf(const Scene& scene, const BVHNode& leaf) {
+    const std::vector<Triangle>& triangles = scene.getTriangles();
+    const std::vector<int>& indices = scene.getTriangleIndices();
+
+    int firstBlock = int(blockTriangles.size()) / width;
+    int blocks = (leaf.triCount + width - 1) / width;
+    // padding lanes stay zero, a triangle without edges never passes the det test
+    triangleBlocks.resize(triangleBlocks.size() + size_t(blocks) * 9 * width, 0.0f);
+    blockTriangles.resize(blockTriangles.size() + size_t(blocks) * width, -1);
+
+    for (int i = 0; i < leaf.triCount; i++) {
+        int block = firstBlock + i / width;
+        int lane = i % width;
+        int triangleIndex = indices[leaf.firstTriIndex + i];
+        const Triangle& tri = triangles[triangleIndex];
+        // the edges are the same subtractions intersectTriangle does, so they round the same
+        glm::vec3 edge1 = tri.v1 - tri.v0;
+        glm::vec3 edge2 = tri.v2 - tri.v0;
+        const float values[9] = { tri.v0.x, tri.v0.y, tri.v0.z, edge1.x, edge1.y, edge1.z, edge2.x, edge2.y, edge2.z };
+
+        float* data = &triangleBlocks[size_t(block) * 9 * width];
+        for (int k = 0; k < 9; k++) {
+            data[k * width + lane] = values[k];
+        }
+        blockTriangles[block * width + lane] = triangleIndex;
+    }
+    return firstBlock;
+}
+
+bool WideBVH::intersect(const glm::vec3& origin, const glm::vec3& dir, float tMin, float tMax, float& closestT, int& hitTriangle,
+    TraversalCounts* counts) const {
+    WideBVHView bvh = { width, nodeBounds.data(), nodeChildren.data(), getNodeCount(), triangleBlocks.data(), blockTriangles.data(), counts };
+    const float rayOrigin[3] = { origin.x, origin.y, origin.z };
+    const float rayDir[3] = { dir.x, dir.y, dir.z };
+
+    float t = tMax;
+    bool hit;
+    switch (isa) {
+    case SimdIsa::Sse: hit = intersectWideSse(bvh, rayOrigin, rayDir, tMin, t, hitTriangle); break;
+    case SimdIsa::Avx2:
+    case SimdIsa::Avx512: hit = intersectWideAvx2(bvh, rayOrigin, rayDir, tMin, t, hitTriangle); break;
+    default: hit = intersectWideScalar(bvh, rayOrigin, rayDir, tMin, t, hitTriangle); break;
+    }
+    if (hit) {
+        closestT = t;
+    }
+    return hit;
+}
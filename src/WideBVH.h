@@ -0,0 +1,57 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include "Scene.h"
+#include "Simd.h"
+#include <vector>
+
+#define MAX_WIDE_BVH_WIDTH 8
+
+// raw views of WideBVH's arrays for the simd kernels, see PacketBVH. all per node and per
+// block data is structure of arrays with one entry per lane
+struct WideBVHView {
+    int width;
+    const float* nodeBounds;     // minX, minY, minZ, maxX, maxY, maxZ, empty slots are inverted boxes
+    const int* nodeChildren;     // child index then triangle block count, a count > 0 makes the
+                                 // child a leaf starting at that block, -1 marks an empty slot
+    int nodeCount;
+    const float* triangleBlocks; // v0 xyz, edge1 xyz, edge2 xyz
+    const int* blockTriangles;   // scene triangle of every lane, -1 for padding
+    TraversalCounts* counts;     // null when nothing is counted
+};
+
+bool intersectWideScalar(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle);
+bool intersectWideSse(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle);
+bool intersectWideAvx2(const WideBVHView& bvh, const float origin[3], const float dir[3], float tMin, float& tMax, int& hitTriangle);
+
+// The scene's binary BVH collapsed into nodes with 4 or 8 children, so one ray tests all
+// children of a node in a single simd compare, and leaves with their triangles in SoA blocks.
+// this is the fast path for the incoherent rays after the first bounce where packets fall apart.
+// 4 wide for sse and the scalar fallback, 8 wide for avx2 and avx-512 (which uses the avx2 kernel)
+class WideBVH {
+public:
+    WideBVH();
+
+    void build(const Scene& scene, SimdIsa isa);
+
+    SimdIsa getIsa() const { return isa; }
+    int getWidth() const { return width; }
+    int getNodeCount() const { return int(nodeChildren.size()) / (2 * width); }
+
+    // same contract as the single ray intersectBVH, closestT and hitTriangle are only written on a hit
+    bool intersect(const glm::vec3& origin, const glm::vec3& dir, float tMin, float tMax, float& closestT, int& hitTriangle,
+        TraversalCounts* counts = nullptr) const;
+
+private:
+    SimdIsa isa;
+    int width;
+    std::vector<float> nodeBounds;
+    std::vector<int> nodeChildren;
+    std::vector<float> triangleBlocks;
+    std::vector<int> blockTriangles;
+
+    int collapse(const Scene& scene, int binaryNode);
+    int addLeaf(const Scene& scene, const BVHNode& leaf);
+};
+
+#endif // WIDE_BVH_H
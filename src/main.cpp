@@ -4,9 +4,23 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
 
 #include "Shader.h"
 #include "RayTracer.h"
+#include "CpuRayTracer.h"
+#include "ToneMap.h"
+#include "OfflineRenderer.h"
+#include "ImageIO.h"
+#include "Denoiser.h"
+#include "BatchRunner.h"
+#include "DistributedRender.h"
+#include "Benchmark.h"
+#include "Microbench.h"
+#include "Regression.h"
+#include <chrono>
 
 const GLuint SCR_WIDTH = 800;
 const GLuint SCR_HEIGHT = 600;
@@ -86,8 +100,355 @@ void processInput(GLFWwindow* window)
         camPos -= currentSpeed * camUp;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // --cpu traces with CpuRayTracer, gl is then only used to show the image
+    // --threads, --tile-size and --tile-order (scanline, morton, hilbert) tune its scheduler,
+    // --isa (scalar, sse, avx2, avx512), --single-ray and --binary-bvh its traversal (--packets and
+    // --wide-bvh force those on where the cpu has no simd and they default to off),
+    // --wavefront traces a bounce of every pixel at a time instead of whole paths,
+    // on the gpu that means the split passes of shaders/wavefront.glsl instead of raytracer.comp,
+    // --persistent traces on the gpu with persistent threads (shaders/persistent.comp)
+    // --progressive MS traces the window at lower resolution while the camera moves to keep
+    // frames near MS milliseconds (33), see RayTracer::setProgressive
+    // --budget MS splits every frame of the window into tiles and only traces what fits into
+    // MS milliseconds per displayed frame, see RayTracer::setFrameBudget
+    // --profile [log] times the gpu stages of every frame (GpuProfiler.h), the window shows them in
+    // its title and gpu runs print percentiles at the end. a log.csv or log.json gets every frame
+    // --counters counts rays per bounce and the bvh nodes, box and triangle tests they cost
+    // (RayCounters.h), the window prints them with Mrays/s every 100 frames, renders at the end
+    // --debug-view nodes|triangles|bounces [scale] shows what tracing every pixel cost instead of
+    // the image (RayTracer::setDebugView), H cycles through the views in the window. headless and
+    // batch images get the same heat ramp, a .pfm keeps the raw costs
+    // --benchmark [suite.txt] flies every scene of the suite (Benchmark.h, the default suite without
+    // one) along its camera path offscreen and writes the timings to --benchmark-output (benchmark.json)
+    // --regress [dir] renders the canonical images of Regression.h on the cpu (--regress-gpu on the gpu)
+    // and fails when one moved away from or has no reference in dir (tests/reference, run from the
+    // repository root), --regress-update writes the references instead
+    // --record-path file saves the camera of every frame of the window there for a benchmark case
+    // --packet-bench prints the camera ray throughput of every isa this cpu has and exits
+    // --microbench times the intersection tests, bvh traversal and builders on their own and exits
+    // --headless renders --samples N (64) at --size W H (800 600) from --camera px py pz tx ty tz
+    // into --output (render.ppm, .pfm keeps the radiance) without a window, on the gpu through an
+    // offscreen context or on the cpu when there is none (or with --cpu), --denoise filters it first
+    // --batch manifest.txt renders every job of the manifest the same way, see BatchRunner.h
+    // --checkpoint S saves the progress of headless and batch renders every S seconds next to
+    // the output, a rerun with the same arguments picks up where a killed one stopped
+    // --coordinator port workers renders the --headless image on that many --worker host:port
+    // processes (cpu tracers, see DistributedRender.h) and writes it to --output
+    bool useCpu = false;
+    bool packetBench = false;
+    bool microbench = false;
+    // same defaults as CpuRayTracer
+    bool packetTracing = detectSimdIsa() != SimdIsa::Scalar;
+    bool wideTraversal = packetTracing;
+    bool wavefront = false;
+    bool persistent = false;
+    float progressiveMs = 0.0f;
+    float budgetMs = 0.0f;
+    bool profile = false;
+    bool countRays = false;
+    DebugView debugView = DebugView::Off;
+    float debugScale = 0.0f;
+    std::string profileLog;
+    SimdIsa simdIsa = detectSimdIsa();
+    int cpuThreads = 0;
+    int tileSize = 16;
+    TileOrder tileOrder = TileOrder::Hilbert;
+    bool headless = false;
+    int samples = 64;
+    std::string outputPath = "render.ppm";
+    int imageWidth = SCR_WIDTH;
+    int imageHeight = SCR_HEIGHT;
+    glm::vec3 cameraTarget = camPos + camFront;
+    bool denoiseOutput = false;
+    std::string batchPath;
+    double checkpointSeconds = 0.0;
+    int coordinatorPort = 0;
+    int workerCount = 0;
+    std::string workerAddress;
+    bool benchmark = false;
+    std::string benchmarkSuite;
+    std::string benchmarkOutput = "benchmark.json";
+    std::string recordPath;
+    bool regression = false;
+    std::string regressionDir = "tests/reference";
+    bool regressionUpdate = false;
+    bool regressionGpu = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--cpu") {
+            useCpu = true;
+        } else if (arg == "--threads" && hasValue) {
+            cpuThreads = std::atoi(argv[++i]);
+        } else if (arg == "--tile-size" && hasValue) {
+            tileSize = std::atoi(argv[++i]);
+        } else if (arg == "--benchmark") {
+            benchmark = true;
+            if (hasValue && argv[i + 1][0] != '-') benchmarkSuite = argv[++i];
+        } else if (arg == "--benchmark-output" && hasValue) {
+            benchmarkOutput = argv[++i];
+        } else if (arg == "--regress") {
+            regression = true;
+            if (hasValue && argv[i + 1][0] != '-') regressionDir = argv[++i];
+        } else if (arg == "--regress-update") {
+            regression = true;
+            regressionUpdate = true;
+        } else if (arg == "--regress-gpu") {
+            regression = true;
+            regressionGpu = true;
+        } else if (arg == "--record-path" && hasValue) {
+            recordPath = argv[++i];
+        } else if (arg == "--microbench") {
+            microbench = true;
+        } else if (arg == "--packet-bench") {
+            packetBench = true;
+        } else if (arg == "--single-ray") {
+            packetTracing = false;
+        } else if (arg == "--binary-bvh") {
+            wideTraversal = false;
+        } else if (arg == "--packets") {
+            packetTracing = true;
+        } else if (arg == "--wide-bvh") {
+            wideTraversal = true;
+        } else if (arg == "--wavefront") {
+            wavefront = true;
+        } else if (arg == "--persistent") {
+            persistent = true;
+        } else if (arg == "--budget" && hasValue) {
+            budgetMs = float(std::atof(argv[++i]));
+        } else if (arg == "--profile") {
+            profile = true;
+            if (hasValue && argv[i + 1][0] != '-') profileLog = argv[++i];
+        } else if (arg == "--debug-view" && hasValue) {
+            std::string view = argv[++i];
+            if (view == "nodes") debugView = DebugView::NodeVisits;
+            else if (view == "triangles") debugView = DebugView::TriangleTests;
+            else if (view == "bounces") debugView = DebugView::PathLength;
+            else std::cout << "Unknown debug view " << view << std::endl;
+            if (i + 1 < argc && argv[i + 1][0] != '-') debugScale = float(std::atof(argv[++i]));
+        } else if (arg == "--counters") {
+            countRays = true;
+        } else if (arg == "--progressive") {
+            progressiveMs = hasValue && argv[i + 1][0] != '-' ? float(std::atof(argv[++i])) : 1000.0f / 30.0f;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--samples" && hasValue) {
+            samples = std::atoi(argv[++i]);
+        } else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else if (arg == "--size" && i + 2 < argc) {
+            imageWidth = std::atoi(argv[++i]);
+            imageHeight = std::atoi(argv[++i]);
+        } else if (arg == "--camera" && i + 6 < argc) {
+            for (int k = 0; k < 3; k++) camPos[k] = float(std::atof(argv[++i]));
+            for (int k = 0; k < 3; k++) cameraTarget[k] = float(std::atof(argv[++i]));
+            camFront = glm::normalize(cameraTarget - camPos);
+        } else if (arg == "--batch" && hasValue) {
+            batchPath = argv[++i];
+        } else if (arg == "--coordinator" && i + 2 < argc) {
+            coordinatorPort = std::atoi(argv[++i]);
+            workerCount = std::atoi(argv[++i]);
+        } else if (arg == "--worker" && hasValue) {
+            workerAddress = argv[++i];
+        } else if (arg == "--checkpoint" && hasValue) {
+            checkpointSeconds = std::atof(argv[++i]);
+        } else if (arg == "--denoise") {
+            denoiseOutput = true;
+        } else if (arg == "--isa" && hasValue) {
+            std::string isa = argv[++i];
+            if (isa == "scalar") simdIsa = SimdIsa::Scalar;
+            else if (isa == "sse") simdIsa = SimdIsa::Sse;
+            else if (isa == "avx2") simdIsa = SimdIsa::Avx2;
+            else if (isa == "avx512") simdIsa = SimdIsa::Avx512;
+            else std::cout << "Unknown isa " << isa << std::endl;
+        } else if (arg == "--tile-order" && hasValue) {
+            std::string order = argv[++i];
+            if (order == "scanline") tileOrder = TileOrder::Scanline;
+            else if (order == "morton") tileOrder = TileOrder::Morton;
+            else if (order == "hilbert") tileOrder = TileOrder::Hilbert;
+            else std::cout << "Unknown tile order " << order << std::endl;
+        } else {
+            std::cout << "Unknown argument " << arg << std::endl;
+        }
+    }
+
+    // same settings for the window and the headless runs
+    auto configureCpu = [&](CpuRayTracer& tracer) {
+        tracer.setThreadCount(cpuThreads);
+        tracer.getScheduler().setTileSize(tileSize);
+        tracer.getScheduler().setTileOrder(tileOrder);
+        tracer.setPacketTracing(packetTracing);
+        tracer.setSimdIsa(simdIsa);
+        tracer.setWideTraversal(wideTraversal);
+        tracer.setWavefront(wavefront);
+        tracer.setRayCounters(countRays);
+    };
+    auto configureGpu = [&](RayTracer& tracer) {
+        if (wavefront) {
+            tracer.setTraceKernel(TraceKernel::Wavefront);
+        } else if (persistent) {
+            tracer.setTraceKernel(TraceKernel::Persistent);
+        }
+        tracer.setRayCounters(countRays);
+        tracer.setDebugView(debugView, debugScale);
+        tracer.getProfiler().setEnabled(profile);
+        if (profile && !profileLog.empty()) {
+            tracer.getProfiler().openLog(profileLog);
+        }
+    };
+
+    if (!workerAddress.empty()) {
+        size_t colon = workerAddress.rfind(':');
+        if (colon == std::string::npos) {
+            std::cout << "--worker needs host:port" << std::endl;
+            return 1;
+        }
+        return runWorker(workerAddress.substr(0, colon), std::atoi(workerAddress.c_str() + colon + 1), configureCpu, std::cout) ? 0 : 1;
+    }
+
+    if (coordinatorPort > 0) {
+        if (denoiseOutput) {
+            std::cout << "The workers send no feature buffers, --denoise is ignored" << std::endl;
+        }
+        DistributedJob job;
+        job.width = imageWidth;
+        job.height = imageHeight;
+        job.camera = { camPos, camPos + camFront, camUp };
+        job.samples = samples;
+        std::vector<glm::dvec4> accumulation;
+        if (!runCoordinator(coordinatorPort, glm::max(workerCount, 1), Scene::defaultScene(), job, accumulation, std::cout)) {
+            return 1;
+        }
+        return writeRadiance(outputPath, imageWidth, imageHeight, averageAccumulation(accumulation)) ? 0 : 1;
+    }
+
+    if (regression) {
+        int failed = runRegression(defaultRegressionSuite(), regressionDir, regressionUpdate, regressionGpu, configureGpu, configureCpu, std::cout);
+        return failed == 0 ? 0 : 1;
+    }
+
+    if (benchmark) {
+        BenchmarkSuite suite = defaultBenchmarkSuite();
+        if (!benchmarkSuite.empty()) {
+            suite = BenchmarkSuite();
+            if (!loadBenchmarkSuite(benchmarkSuite, suite)) {
+                return 1;
+            }
+        }
+        return runBenchmark(suite, useCpu, configureGpu, configureCpu, benchmarkOutput, std::cout) ? 0 : 1;
+    }
+
+    if (!batchPath.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        BatchManifest manifest;
+        if (!loadBatchManifest(batchPath, manifest)) {
+            return 1;
+        }
+        OfflineRenderer renderer(manifest.width, manifest.height, std::move(manifest.scene), useCpu);
+        if (renderer.onGpu()) {
+            configureGpu(*renderer.getRayTracer());
+        } else {
+            configureCpu(*renderer.getCpuRayTracer());
+        }
+        renderer.setCheckpointInterval(checkpointSeconds);
+        std::cout << "Scene ready in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+            << " s, " << manifest.jobs.size() << " jobs" << std::endl;
+        int failed = runBatch(renderer, manifest.jobs, std::cout, checkpointSeconds > 0.0);
+        if (profile && renderer.onGpu()) {
+            renderer.getRayTracer()->getProfiler().flush();
+            renderer.getRayTracer()->getProfiler().printStats(std::cout);
+        }
+        return failed == 0 ? 0 : 1;
+    }
+
+    if (headless) {
+        OfflineRenderer renderer(imageWidth, imageHeight, Scene::defaultScene(), useCpu);
+        if (renderer.onGpu()) {
+            configureGpu(*renderer.getRayTracer());
+        } else {
+            configureCpu(*renderer.getCpuRayTracer());
+        }
+
+        renderer.setCheckpointInterval(checkpointSeconds);
+        std::string checkpointPath = checkpointSeconds > 0.0 ? outputPath + ".checkpoint" : "";
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<glm::vec4> image = averageAccumulation(renderer.render({ camPos, camPos + camFront, camUp }, samples, checkpointPath));
+        auto end = std::chrono::steady_clock::now();
+        std::cout << samples << " samples at " << imageWidth << "x" << imageHeight << " in "
+            << std::chrono::duration<double>(end - start).count() << " s" << std::endl;
+        if (countRays) {
+            RayCounters counters = renderer.onGpu() ? renderer.getRayTracer()->getRayCounters(true) : renderer.getCpuRayTracer()->getRayCounters();
+            printRayCounters(std::cout, counters, std::chrono::duration<double>(end - start).count());
+        }
+        if (profile && renderer.onGpu()) {
+            renderer.getRayTracer()->getProfiler().flush();
+            renderer.getRayTracer()->getProfiler().printStats(std::cout);
+        }
+
+        // a debug view holds costs instead of radiance, there is nothing to denoise
+        bool debugImage = renderer.onGpu() && renderer.getRayTracer()->getDebugView() != DebugView::Off;
+        if (denoiseOutput && !debugImage) {
+            image = Denoiser().denoise(image, renderer.getAlbedo(), renderer.getNormalDepth(), imageWidth, imageHeight);
+        }
+        bool written = debugImage
+            ? writeDebugView(outputPath, imageWidth, imageHeight, image, renderer.getRayTracer()->getDebugScale())
+            : writeRadiance(outputPath, imageWidth, imageHeight, image);
+        if (!written) {
+            return 1;
+        }
+        if (!checkpointPath.empty()) {
+            std::remove(checkpointPath.c_str());
+        }
+        return 0;
+    }
+
+    if (microbench) {
+        runMicrobench(std::cout);
+        return 0;
+    }
+
+    if (packetBench) {
+        CpuRayTracer bench(SCR_WIDTH, SCR_HEIGHT, Scene::defaultScene());
+        bench.setThreadCount(cpuThreads);
+        bench.getScheduler().setTileSize(tileSize);
+        bench.getScheduler().setTileOrder(tileOrder);
+        bench.setSimdIsa(simdIsa);
+        const int frames = 10;
+
+        // single rays, camera and diffuse, through the binary and the wide bvh
+        bench.setPacketTracing(false);
+        bench.setWideTraversal(false);
+        std::cout << "single ray binary bvh: " << bench.measurePrimaryRays(camPos, camPos + camFront, camUp, frames)
+            << " Mrays/s camera, " << bench.measureDiffuseRays(camPos, camPos + camFront, camUp, frames) << " Mrays/s diffuse" << std::endl;
+        bench.setWideTraversal(true);
+        const SimdIsa wideIsas[] = { SimdIsa::Scalar, SimdIsa::Sse, SimdIsa::Avx2 };
+        for (SimdIsa isa : wideIsas) {
+            if (!isSimdIsaSupported(isa)) {
+                continue;
+            }
+            bench.setSimdIsa(isa);
+            std::cout << "single ray " << simdIsaName(isa) << " bvh" << bench.getWideBVHWidth() << ": "
+                << bench.measurePrimaryRays(camPos, camPos + camFront, camUp, frames) << " Mrays/s camera, "
+                << bench.measureDiffuseRays(camPos, camPos + camFront, camUp, frames) << " Mrays/s diffuse" << std::endl;
+        }
+
+        bench.setPacketTracing(true);
+        const SimdIsa isas[] = { SimdIsa::Scalar, SimdIsa::Sse, SimdIsa::Avx2, SimdIsa::Avx512 };
+        for (SimdIsa isa : isas) {
+            if (!isSimdIsaSupported(isa)) {
+                std::cout << simdIsaName(isa) << ": not supported" << std::endl;
+                continue;
+            }
+            bench.setSimdIsa(isa);
+            std::cout << simdIsaName(isa) << " packets of " << packetWidth(isa) << ": "
+                << bench.measurePrimaryRays(camPos, camPos + camFront, camUp, frames) << " Mrays/s" << std::endl;
+        }
+        return 0;
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -112,7 +473,31 @@ int main()
     // for displaying the texture
     Shader displayShader("shaders/quad.vert", "shaders/quad.frag");
 
-    RayTracer rayTracer(SCR_WIDTH, SCR_HEIGHT);
+    RayTracer* rayTracer = nullptr;
+    CpuRayTracer* cpuRayTracer = nullptr;
+    GLuint cpuTexture = 0;
+    if (useCpu) {
+        cpuRayTracer = new CpuRayTracer(SCR_WIDTH, SCR_HEIGHT, Scene::defaultScene());
+        configureCpu(*cpuRayTracer);
+        std::cout << "Tracing on the cpu with " << cpuRayTracer->getThreadCount() << " threads" << std::endl;
+
+        glGenTextures(1, &cpuTexture);
+        glBindTexture(GL_TEXTURE_2D, cpuTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    } else {
+        rayTracer = new RayTracer(SCR_WIDTH, SCR_HEIGHT);
+        configureGpu(*rayTracer);
+        // only for the window, offline renders take the samples they were asked for
+        if (progressiveMs > 0.0f) {
+            rayTracer->setProgressive(true);
+            rayTracer->setProgressiveTarget(progressiveMs);
+        }
+        rayTracer->setFrameBudget(budgetMs);
+    }
 
     GLuint quadVAO, quadVBO, quadEBO;
     glGenVertexArrays(1, &quadVAO);
@@ -139,6 +524,13 @@ int main()
     // also we can pass a random seed from the cpu when we're calling the render function but i dont think we need that true randomness
     // so we'll stick with suedo random number i guess with using hashfunction or whaterver the magic it does
 
+    // --counters prints the rays traced since the last report
+    RayCounters reportedCounters;
+    double reportedTime = glfwGetTime();
+    int framesSinceReport = 0;
+    bool debugKeyDown = false;
+    std::vector<RenderCamera> recordedPath;
+
     // main render loop
     while (!glfwWindowShouldClose(window))
     {
@@ -161,11 +553,55 @@ int main()
 
         processInput(window);
 
+        bool debugKeyPressed = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+        if (rayTracer && debugKeyPressed && !debugKeyDown) {
+            // off, nodes, triangles, bounces and around again
+            DebugView next = DebugView((static_cast<int>(rayTracer->getDebugView()) + 1) % 4);
+            rayTracer->setDebugView(next, next == debugView ? debugScale : 0.0f);
+        }
+        debugKeyDown = debugKeyPressed;
+
+        if (!recordPath.empty()) {
+            recordedPath.push_back({ camPos, camPos + camFront, camUp });
+        }
+
         // compute the ray traced image
-        rayTracer.render(camPos, camPos + camFront, camUp);
+        GLuint displayTexture;
+        if (cpuRayTracer) {
+            cpuRayTracer->render(camPos, camPos + camFront, camUp);
+            // how evenly the tiles spread over the threads, every so often
+            if (cpuRayTracer->getFrameCount() % 100 == 1) {
+                cpuRayTracer->getScheduler().printStats(std::cout);
+            }
+            std::vector<glm::vec4> pixels = toneMapAccumulation(cpuRayTracer->getAccumulation(), 0.0f, ToneMapper::None, 1.0f);
+            glBindTexture(GL_TEXTURE_2D, cpuTexture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGBA, GL_FLOAT, pixels.data());
+            displayTexture = cpuTexture;
+        } else {
+            rayTracer->render(camPos, camPos + camFront, camUp);
+            displayTexture = rayTracer->getOutputTexture();
+        }
+
+        if (countRays && ++framesSinceReport == 100) {
+            // the gpu totals lag a frame or two behind, that evens out over the interval
+            RayCounters counters = cpuRayTracer ? cpuRayTracer->getRayCounters() : rayTracer->getRayCounters();
+            double now = glfwGetTime();
+            printRayCounters(std::cout, counters - reportedCounters, now - reportedTime);
+            reportedCounters = counters;
+            reportedTime = now;
+            framesSinceReport = 0;
+        }
 
         float fps = 1.0f / deltaTime;
         std::string title = "FPS:" + std::to_string(fps);
+        if (rayTracer && profile) {
+            const GpuProfiler& profiler = rayTracer->getProfiler();
+            char stages[128];
+            std::snprintf(stages, sizeof(stages), " gpu ms trace %.2f denoise %.2f display %.2f",
+                profiler.getAverageMs("trace"), profiler.getAverageMs("denoise"),
+                profiler.getAverageMs("tonemap") + profiler.getAverageMs("present"));
+            title += stages;
+        }
         glfwSetWindowTitle(window, title.c_str());
 
         glClear(GL_COLOR_BUFFER_BIT);
@@ -174,9 +610,12 @@ int main()
         displayShader.use();
         glActiveTexture(GL_TEXTURE0);
         // rendering the object simply
-        glBindTexture(GL_TEXTURE_2D, rayTracer.getOutputTexture());
+        glBindTexture(GL_TEXTURE_2D, displayTexture);
         glBindVertexArray(quadVAO);
+        // the quad belongs to the frame render just profiled
+        if (rayTracer) rayTracer->getProfiler().begin("present");
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        if (rayTracer) rayTracer->getProfiler().end();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -185,6 +624,16 @@ int main()
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
     glDeleteBuffers(1, &quadEBO);
+    glDeleteTextures(1, &cpuTexture);
+    if (rayTracer && profile) {
+        rayTracer->getProfiler().flush();
+        rayTracer->getProfiler().printStats(std::cout);
+    }
+    if (!recordPath.empty() && saveCameraPath(recordPath, recordedPath)) {
+        std::cout << recordedPath.size() << " cameras saved to " << recordPath << std::endl;
+    }
+    delete rayTracer;
+    delete cpuRayTracer;
 
     glfwTerminate();
     return 0;